@@ -4,9 +4,25 @@
 // For now, only 256RFR2 is supported
 #define HAL_ATMEGA256RFR2
 #define PHY_ATMEGARFR2
+// True random bits seed the jitter generator, see SYS_RandomInit()
+#define PHY_ENABLE_RANDOM_NUMBER_GENERATOR
 //#define NWK_ENABLE_MULTICAST
 #define NWK_ENABLE_ROUTING
-#define NWK_BUFFERS_AMOUNT 6
+#define NWK_ENABLE_BEACONS
+// Absorb ping bursts from several anchors while the loop is busy
+#define PHY_RX_BUFFERS_AMOUNT 4
+#define NWK_BUFFERS_AMOUNT 4
+#define NWK_SMALL_BUFFERS_AMOUNT 8
+// Keep frames for ACKs, commands and reports during ping floods
+#define NWK_BUFFERS_APP_TX_RESERVE 1
+#define NWK_BUFFERS_ACK_RESERVE 2
+#define NWK_BUFFERS_COMMAND_RESERVE 1
+#define NWK_BUFFERS_RX_MAX 6
+#define NWK_BUFFERS_FORWARD_MAX 4
+#define NWK_BROADCAST_SUPPRESSION_THRESHOLD 2
 #define NWK_ACK_WAIT_TIME 100 // ms
+#define SYS_ENABLE_LOOP_MONITOR
+#define SYS_ENABLE_TIMER_STATS
+#define SYS_ENABLE_TICKLESS
 
 #endif // _LWM_CONFIG_H
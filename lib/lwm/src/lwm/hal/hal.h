@@ -38,7 +38,7 @@
 #include <Arduino.h>
 
 inline void HAL_Init(void) { /* Nothing to do */ }
-inline void HAL_Delay(uint8_t us) { delay(us); }
+inline void HAL_Delay(uint8_t us) { delayMicroseconds(us); }
 
 #endif // _HAL_H_
 
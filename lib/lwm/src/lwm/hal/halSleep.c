@@ -0,0 +1,245 @@
+/**
+ * \file halSleep.c
+ *
+ * \brief Idle sleep implementation
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <string.h>
+#include <avr/sleep.h>
+#include "../sys/sysTypes.h"
+#include "../hal/hal.h"
+#include "../hal/halTimer.h"
+#include "../hal/halSleep.h"
+#include "../sys/sysTimer.h"
+
+#ifdef SYS_ENABLE_TICKLESS
+
+/*- Definitions ------------------------------------------------------------*/
+// Longest single sleep, well within the wrap around of the time base
+#define HAL_SLEEP_MAX_TIME         60000000ul // us
+
+// Shorter sleeps keep Timer0 running, they would not skip many of its ticks
+#define HAL_SLEEP_TIMER0_STOP_TIME 2048 // us
+
+// Timer0 runs with the prescaler of 64 set by the Arduino core
+#define HAL_SLEEP_TIMER0_PRESCALER 64
+#define HAL_SLEEP_TIMER0_CLOCK     ((1 << CS02) | (1 << CS01) | (1 << CS00))
+#define HAL_SLEEP_TIMER0_TICKS_PER_SYMBOL \
+            (HAL_SYMBOL_PERIOD * (F_CPU / 1000000ul) / HAL_SLEEP_TIMER0_PRESCALER)
+
+/*- Prototypes -------------------------------------------------------------*/
+static uint32_t halSleepSymbolCounter(void);
+static void halSleepSetCompare(uint32_t symbols);
+static void halSleepTimer0Stop(void);
+static void halSleepTimer0Resume(void);
+
+/*- Variables --------------------------------------------------------------*/
+// Time base of the Arduino core, advanced here while Timer0 is stopped
+extern volatile unsigned long timer0_overflow_count;
+extern volatile unsigned long timer0_millis;
+
+static HAL_SleepStats_t halSleepStats;
+static volatile bool halSleepWakeupRequest;
+static volatile uint32_t halSleepWakeupTime;
+static volatile bool halSleepTimer0Stopped;
+static uint8_t halSleepTimer0Clock;
+static uint32_t halSleepTimer0StopSymbol;
+static uint16_t halSleepMillisRest; // us
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Starts the symbol counter, which keeps running from the transceiver
+         clock while the CPU is sleeping
+*****************************************************************************/
+void HAL_SleepInit(void)
+{
+  SCCR0 |= (1 << SCEN);
+  SCIRQM = 0;
+  SCIRQS = (1 << IRQSCP1);
+
+  halSleepWakeupRequest = false;
+  halSleepWakeupTime = SYS_TIMER_NO_DEADLINE;
+  halSleepTimer0Stopped = false;
+  halSleepMillisRest = 0;
+  HAL_SleepStatsReset();
+}
+
+/*************************************************************************//**
+  @brief Sleeps in idle mode for @a us or until HAL_SleepWakeup() is called.
+         Long sleeps stop Timer0, so its overflow interrupt does not wake
+         the CPU every 1 ms, and advance the time base by the symbol counter
+         on the wake up. While the transceiver sleeps the symbol counter is
+         stopped as well, then Timer0 keeps running and wakes the CPU.
+  @param[in] us Maximum sleep time, us
+*****************************************************************************/
+void HAL_IdleSleep(uint32_t us)
+{
+  uint32_t start = halTimerMicros;
+  uint32_t end;
+  bool pending;
+
+  // A wake up requested before going to sleep is an event that has not
+  // been handled yet
+  ATOMIC_SECTION_ENTER
+    pending = halSleepWakeupRequest;
+    halSleepWakeupRequest = false;
+    halSleepWakeupTime = SYS_TIMER_NO_DEADLINE;
+  ATOMIC_SECTION_LEAVE
+
+  if (pending)
+    return;
+
+  if (us > HAL_SLEEP_MAX_TIME)
+    us = HAL_SLEEP_MAX_TIME;
+
+  halSleepSetCompare(us / HAL_SYMBOL_PERIOD);
+
+  set_sleep_mode(SLEEP_MODE_IDLE);
+
+  cli();
+
+  // The compare match, or any other wake up, resumes Timer0
+  if (us >= HAL_SLEEP_TIMER0_STOP_TIME && !(TRXPR & (1 << SLPTR)))
+    halSleepTimer0Stop();
+
+  // The time base is checked as well, so a stopped symbol counter
+  // (transceiver in sleep) only costs precision, not the deadline
+  while (!halSleepWakeupRequest && (halTimerMicros - start) < us)
+  {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+  }
+  halSleepTimer0Resume();
+  halSleepWakeupRequest = false;
+  sei();
+
+  SCIRQM &= ~(1 << IRQMCP1);
+
+  end = halTimerMicros;
+
+  halSleepStats.sleepTime += end - start;
+  halSleepStats.wakeups++;
+
+  if (SYS_TIMER_NO_DEADLINE != halSleepWakeupTime)
+  {
+    uint32_t latency = end - halSleepWakeupTime;
+
+    halSleepStats.wakeLatency += latency;
+    if (latency > halSleepStats.maxWakeLatency)
+      halSleepStats.maxWakeLatency = latency;
+  }
+}
+
+/*************************************************************************//**
+  @brief Requests the end of the current (or the next) sleep, interrupt context.
+         The time base is up to date again when this returns.
+*****************************************************************************/
+void HAL_SleepWakeup(void)
+{
+  halSleepTimer0Resume();
+
+  if (SYS_TIMER_NO_DEADLINE == halSleepWakeupTime)
+    halSleepWakeupTime = halTimerMicros;
+  halSleepWakeupRequest = true;
+}
+
+/*************************************************************************//**
+  @brief Returns the statistics collected since the last reset
+*****************************************************************************/
+HAL_SleepStats_t *HAL_SleepStats(void)
+{
+  return &halSleepStats;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void HAL_SleepStatsReset(void)
+{
+  memset(&halSleepStats, 0, sizeof(HAL_SleepStats_t));
+  halSleepStats.start = halTimerMicros;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint32_t halSleepSymbolCounter(void)
+{
+  uint32_t value;
+
+  // Reading the low byte latches the upper ones
+  value = SCCNTLL;
+  value |= (uint32_t)SCCNTLH << 8;
+  value |= (uint32_t)SCCNTHL << 16;
+  value |= (uint32_t)SCCNTHH << 24;
+
+  return value;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void halSleepSetCompare(uint32_t symbols)
+{
+  uint32_t compare = halSleepSymbolCounter() + symbols;
+
+  while (SCSR & (1 << SCBSY));
+
+  // Writing the low byte updates the whole register
+  SCOCR1HH = compare >> 24;
+  SCOCR1HL = compare >> 16;
+  SCOCR1LH = compare >> 8;
+  SCOCR1LL = compare;
+
+  SCIRQS = (1 << IRQSCP1);
+  SCIRQM |= (1 << IRQMCP1);
+}
+
+/*************************************************************************//**
+  @brief Stops Timer0 and notes the symbol counter, interrupts disabled
+*****************************************************************************/
+static void halSleepTimer0Stop(void)
+{
+  halSleepTimer0Clock = TCCR0B & HAL_SLEEP_TIMER0_CLOCK;
+  TCCR0B &= ~HAL_SLEEP_TIMER0_CLOCK;
+  halSleepTimer0StopSymbol = halSleepSymbolCounter();
+  halSleepTimer0Stopped = true;
+}
+
+/*************************************************************************//**
+  @brief Adds the symbols counted since halSleepTimer0Stop() to the Timer0
+         count and to the millisecond counter of the Arduino core, then
+         restarts Timer0. The time base loses less than a symbol per sleep.
+         Interrupts disabled.
+*****************************************************************************/
+static void halSleepTimer0Resume(void)
+{
+  uint32_t symbols, ticks, us;
+
+  if (!halSleepTimer0Stopped)
+    return;
+
+  symbols = halSleepSymbolCounter() - halSleepTimer0StopSymbol;
+  ticks = TCNT0 + symbols * HAL_SLEEP_TIMER0_TICKS_PER_SYMBOL;
+  us = symbols * HAL_SYMBOL_PERIOD + halSleepMillisRest;
+
+  timer0_overflow_count += ticks >> 8;
+  timer0_millis += us / 1000;
+  halSleepMillisRest = us % 1000;
+
+  TCNT0 = ticks;
+  TCCR0B |= halSleepTimer0Clock;
+  halSleepTimer0Stopped = false;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+ISR(SCNT_CMP1_vect)
+{
+  HAL_SleepWakeup();
+}
+
+#endif // SYS_ENABLE_TICKLESS
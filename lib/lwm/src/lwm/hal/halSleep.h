@@ -0,0 +1,55 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * \file halSleep.h
+ *
+ * \brief Idle sleep interface
+ *
+ * Puts the MCU in idle sleep until a deadline programmed on the symbol
+ * counter compare unit 1 or until an interrupt that requests a wake up
+ * through HAL_SleepWakeup(). The Arduino core runs Timer0 for micros()
+ * and millis(); its overflow interrupt would wake the CPU every ~1 ms, so
+ * long sleeps stop Timer0 and advance its counters by the symbol counter
+ * on the wake up. Interrupt handlers that read the time while the CPU
+ * sleeps must call HAL_SleepWakeup() first. PWM on the Timer0 pins stops
+ * during these sleeps.
+ *
+ */
+
+#ifndef _HAL_SLEEP_H_
+#define _HAL_SLEEP_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "../sys/sysConfig.h"
+
+#ifdef SYS_ENABLE_TICKLESS
+
+/*- Definitions ------------------------------------------------------------*/
+#define HAL_SYMBOL_PERIOD          16 // us
+
+/*- Types ------------------------------------------------------------------*/
+typedef struct HAL_SleepStats_t
+{
+  uint32_t     start;           // time of the last reset, us
+  uint32_t     sleepTime;       // accumulated, us
+  uint32_t     wakeups;
+  uint32_t     wakeLatency;     // accumulated, us
+  uint32_t     maxWakeLatency;  // us
+} HAL_SleepStats_t;
+
+/*- Prototypes -------------------------------------------------------------*/
+void HAL_SleepInit(void);
+void HAL_IdleSleep(uint32_t us);
+void HAL_SleepWakeup(void);
+HAL_SleepStats_t *HAL_SleepStats(void);
+void HAL_SleepStatsReset(void);
+
+#endif // SYS_ENABLE_TICKLESS
+
+#endif // _HAL_SLEEP_H_
+#ifdef __cplusplus
+}
+#endif
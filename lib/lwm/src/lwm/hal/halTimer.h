@@ -45,4 +45,10 @@
 
 #define halTimerIrqCount (millis())
 
+// Microsecond timestamps, again taken from the Arduino core instead of
+// from a dedicated timer. This is the time base of the system timers and
+// of the latency measurements; it wraps around every ~71 minutes, so
+// always compare differences of unsigned values.
+#define halTimerMicros (micros())
+
 #endif // _HAL_TIMER_H_
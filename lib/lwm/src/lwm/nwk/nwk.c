@@ -51,6 +51,7 @@
 #include <string.h>
 #include "../phy/phy.h"
 #include "../sys/sysConfig.h"
+#include "../sys/sysRandom.h"
 #include "../nwk/nwkRx.h"
 #include "../nwk/nwkTx.h"
 #include "../nwk/nwkGroup.h"
@@ -61,6 +62,7 @@
 
 /*- Variables --------------------------------------------------------------*/
 NwkIb_t nwkIb;
+NWK_Stats_t nwkStats;
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -74,8 +76,15 @@ void NWK_Init(void)
   nwkIb.addr = 0;
   nwkIb.lock = 0;
 
+  NWK_StatsReset();
+
   for (uint8_t i = 0; i < NWK_ENDPOINTS_AMOUNT; i++)
+  {
     nwkIb.endpoint[i] = NULL;
+  #ifdef NWK_ENABLE_BATCH_INDICATION
+    nwkIb.batchEndpoint[i] = NULL;
+  #endif
+  }
 
   nwkTxInit();
   nwkRxInit();
@@ -107,6 +116,10 @@ void NWK_SetAddr(uint16_t addr)
 {
   nwkIb.addr = addr;
   PHY_SetShortAddr(addr);
+
+#ifndef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
+  SYS_RandomSeed(addr);
+#endif
 }
 
 /*************************************************************************//**
@@ -129,6 +142,23 @@ void NWK_OpenEndpoint(uint8_t id, bool (*handler)(NWK_DataInd_t *ind))
   nwkIb.endpoint[id] = handler;
 }
 
+#ifdef NWK_ENABLE_BATCH_INDICATION
+/*************************************************************************//**
+  @brief Registers batch callback @a handler for the endpoint @a id. Frames
+         for the endpoint that are ready in the same Rx task pass are
+         indicated together, up to NWK_BATCH_INDICATION_SIZE at a time, and
+         released when the callback returns. The callback sets ack[i] to
+         request an acknowledgement of ind[i]; the control value set with
+         NWK_SetAckControl() applies to all of them.
+  @param[in] id Endpoint index (1-15)
+  @param[in] handler Pointer to the callback function
+*****************************************************************************/
+void NWK_OpenBatchEndpoint(uint8_t id, void (*handler)(NWK_DataInd_t *ind, bool *ack, uint8_t count))
+{
+  nwkIb.batchEndpoint[id] = handler;
+}
+#endif
+
 /*************************************************************************//**
   @brief Checks if network layer is ready for sleep
   @return @c true if network layer is ready for sleep or @c false otherwise
@@ -170,6 +200,22 @@ void NWK_WakeupReq(void)
   PHY_Wakeup();
 }
 
+/*************************************************************************//**
+  @brief Returns the network layer counters
+*****************************************************************************/
+NWK_Stats_t *NWK_Stats(void)
+{
+  return &nwkStats;
+}
+
+/*************************************************************************//**
+  @brief Clears the network layer counters
+*****************************************************************************/
+void NWK_StatsReset(void)
+{
+  memset(&nwkStats, 0, sizeof(NWK_Stats_t));
+}
+
 /*************************************************************************//**
   @brief Calculates linearized value for the given value of the LQI
   @param[in] lqi LQI value as provided by the transceiver
@@ -67,6 +67,8 @@ extern "C" {
 
 #define NWK_ENDPOINTS_AMOUNT            16
 
+#define NWK_TX_DELAY_HISTOGRAM_SIZE     8
+
 /*- Types ------------------------------------------------------------------*/
 typedef enum
 {
@@ -81,6 +83,17 @@ typedef enum
   NWK_PHY_NO_ACK_STATUS                   = 0x21,
 } NWK_Status_t;
 
+// Traffic classes sharing the frame pool, see NWK_BUFFERS_*_RESERVE/MAX
+enum
+{
+  NWK_FRAME_CLASS_RX       = 0,
+  NWK_FRAME_CLASS_APP_TX   = 1,
+  NWK_FRAME_CLASS_ACK      = 2,
+  NWK_FRAME_CLASS_FORWARD  = 3,
+  NWK_FRAME_CLASS_COMMAND  = 4,
+  NWK_FRAME_CLASSES_AMOUNT,
+};
+
 typedef struct NwkIb_t
 {
   uint16_t     addr;
@@ -88,26 +101,54 @@ typedef struct NwkIb_t
   uint8_t      nwkSeqNum;
   uint8_t      macSeqNum;
   bool         (*endpoint[NWK_ENDPOINTS_AMOUNT])(NWK_DataInd_t *ind);
+#ifdef NWK_ENABLE_BATCH_INDICATION
+  void         (*batchEndpoint[NWK_ENDPOINTS_AMOUNT])(NWK_DataInd_t *ind, bool *ack, uint8_t count);
+#endif
 #ifdef NWK_ENABLE_SECURITY
   uint32_t     key[4];
 #endif
   uint16_t     lock;
 } NwkIb_t;
 
+typedef struct NWK_Stats_t
+{
+  uint32_t     allocFailures;
+  uint8_t      framesMaxUsed;
+  uint8_t      smallFramesMaxUsed;
+  uint16_t     classExhausted[NWK_FRAME_CLASSES_AMOUNT];
+  uint16_t     duplicateEvictions;
+  uint16_t     rebroadcasts;
+  uint16_t     rebroadcastsSuppressed;
+  uint16_t     rebroadcastsSkipped;
+  uint16_t     beaconsDropped;
+  uint16_t     rxPoolFull; // received frames dropped for the lack of a buffer
+  uint16_t     txRetries;
+  uint16_t     aggregated; // payloads sent inside aggregate frames
+  // Time from ready to send to handed to the PHY, bucket i holds the delays
+  // below NWK_TX_DELAY_RESOLUTION << i, the last one everything above
+  uint16_t     txQueueDelay[NWK_FRAME_CLASSES_AMOUNT][NWK_TX_DELAY_HISTOGRAM_SIZE];
+} NWK_Stats_t;
+
 /*- Variables --------------------------------------------------------------*/
 extern NwkIb_t nwkIb;
+extern NWK_Stats_t nwkStats;
 
 /*- Prototypes -------------------------------------------------------------*/
 void NWK_Init(void);
 void NWK_SetAddr(uint16_t addr);
 void NWK_SetPanId(uint16_t panId);
 void NWK_OpenEndpoint(uint8_t id, bool (*handler)(NWK_DataInd_t *ind));
+#ifdef NWK_ENABLE_BATCH_INDICATION
+void NWK_OpenBatchEndpoint(uint8_t id, void (*handler)(NWK_DataInd_t *ind, bool *ack, uint8_t count));
+#endif
 bool NWK_Busy(void);
 void NWK_Lock(void);
 void NWK_Unlock(void);
 void NWK_SleepReq(void);
 void NWK_WakeupReq(void);
 void NWK_TaskHandler(void);
+NWK_Stats_t *NWK_Stats(void);
+void NWK_StatsReset(void);
 
 uint8_t NWK_LinearizeLqi(uint8_t lqi);
 
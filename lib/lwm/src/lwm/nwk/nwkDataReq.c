@@ -88,20 +88,14 @@ void NWK_DataReq(NWK_DataReq_t *req)
 {
   req->state = NWK_DATA_REQ_STATE_INITIAL;
   req->status = NWK_SUCCESS_STATUS;
-  req->frame = NULL;
 
   nwkIb.lock++;
 
-  if (NULL == nwkDataReqQueue)
-  {
-    req->next = NULL;
-    nwkDataReqQueue = req;
-  }
-  else
-  {
-    req->next = nwkDataReqQueue;
-    nwkDataReqQueue = req;
-  }
+  req->prev = NULL;
+  req->next = nwkDataReqQueue;
+  if (nwkDataReqQueue)
+    nwkDataReqQueue->prev = req;
+  nwkDataReqQueue = req;
 }
 
 /*************************************************************************//**
@@ -111,23 +105,63 @@ void NWK_DataReq(NWK_DataReq_t *req)
 static void nwkDataReqSendFrame(NWK_DataReq_t *req)
 {
   NwkFrame_t *frame;
+  bool copy = false;
+  uint8_t size = 0;
+
+  // Secured frames are encrypted in place, so only they carry a copy of the
+  // payload; the others send it straight from the request
+#ifdef NWK_ENABLE_SECURITY
+  copy = (req->options & NWK_OPT_ENABLE_SECURITY) ? true : false;
+#endif
+
+  if (copy)
+    size += req->size;
 
-  if (NULL == (frame = nwkFrameAlloc()))
+#ifdef NWK_ENABLE_MULTICAST
+  if (req->options & NWK_OPT_MULTICAST)
+    size += sizeof(NwkFrameMulticastHeader_t);
+#endif
+
+  if (NULL == (frame = nwkFrameAlloc(NWK_FRAME_CLASS_APP_TX, size)))
   {
     req->state = NWK_DATA_REQ_STATE_CONFIRM;
     req->status = NWK_OUT_OF_MEMORY_STATUS;
     return;
   }
 
-  req->frame = frame;
   req->state = NWK_DATA_REQ_STATE_WAIT_CONF;
 
   frame->tx.confirm = nwkDataReqTxConf;
+  frame->tx.request = req;
   frame->tx.control = req->options & NWK_OPT_BROADCAST_PAN_ID ? NWK_TX_CONTROL_BROADCAST_PAN_ID : 0;
+  frame->tx.retries = req->maxRetries;
+  frame->tx.backoff = req->backoff;
+
+  if (req->options & NWK_OPT_RETRY_CHANNEL_ACCESS_ONLY)
+    frame->tx.control |= NWK_TX_CONTROL_RETRY_CHANNEL_ACCESS_ONLY;
+
+#ifdef NWK_ENABLE_AGGREGATION
+  // Only plain unicast frames may share a frame, the others need their own
+  // header fields or acknowledgement
+  if ((req->options & NWK_OPT_AGGREGATE) && NWK_BROADCAST_ADDR != req->dstAddr &&
+      0 == (req->options & (NWK_OPT_ACK_REQUEST | NWK_OPT_ENABLE_SECURITY |
+      NWK_OPT_BROADCAST_PAN_ID | NWK_OPT_MULTICAST | NWK_OPT_BEACON)))
+    frame->tx.control |= NWK_TX_CONTROL_AGGREGATE;
+#endif
 
   frame->header.nwkFcf.ackRequest = req->options & NWK_OPT_ACK_REQUEST ? 1 : 0;
   frame->header.nwkFcf.linkLocal = req->options & NWK_OPT_LINK_LOCAL ? 1 : 0;
 
+#ifdef NWK_ENABLE_BEACONS
+  // Beacons are never acknowledged nor forwarded
+  if (req->options & NWK_OPT_BEACON)
+  {
+    frame->header.nwkFcf.beacon = 1;
+    frame->header.nwkFcf.linkLocal = 1;
+    frame->header.nwkFcf.ackRequest = 0;
+  }
+#endif
+
 #ifdef NWK_ENABLE_SECURITY
   frame->header.nwkFcf.security = req->options & NWK_OPT_ENABLE_SECURITY ? 1 : 0;
 #endif
@@ -155,8 +189,16 @@ static void nwkDataReqSendFrame(NWK_DataReq_t *req)
   frame->header.nwkSrcEndpoint = req->srcEndpoint;
   frame->header.nwkDstEndpoint = req->dstEndpoint;
 
-  memcpy(frame->payload, req->data, req->size);
-  frame->size += req->size;
+  if (copy)
+  {
+    memcpy(frame->payload, req->data, req->size);
+    frame->size += req->size;
+  }
+  else
+  {
+    frame->tx.data = req->data;
+    frame->tx.size = req->size;
+  }
 
   nwkTxFrame(frame);
 }
@@ -167,37 +209,33 @@ static void nwkDataReqSendFrame(NWK_DataReq_t *req)
 *****************************************************************************/
 static void nwkDataReqTxConf(NwkFrame_t *frame)
 {
-  for (NWK_DataReq_t *req = nwkDataReqQueue; req; req = req->next)
-  {
-    if (req->frame == frame)
-    {
-      req->status = frame->tx.status;
-      req->control = frame->tx.control;
-      req->state = NWK_DATA_REQ_STATE_CONFIRM;
-      break;
-    }
-  }
+  NWK_DataReq_t *req = frame->tx.request;
+
+  req->status = frame->tx.status;
+  req->control = frame->tx.control;
+  req->retries = frame->tx.retried;
+  req->state = NWK_DATA_REQ_STATE_CONFIRM;
 
   nwkFrameFree(frame);
 }
 
 /*************************************************************************//**
-  @brief Confirms request @req to the application and remove it from the queue
+  @brief Confirms request @req to the application and remove it from the queue.
+         The queue is linked both ways, so the removal takes constant time.
   @param[in] req Pointer to the request parameters
 *****************************************************************************/
 static void nwkDataReqConfirm(NWK_DataReq_t *req)
 {
-  if (nwkDataReqQueue == req)
-  {
-    nwkDataReqQueue = nwkDataReqQueue->next;
-  }
+  NWK_DataReq_t *prev = req->prev;
+  NWK_DataReq_t *next = req->next;
+
+  if (prev)
+    prev->next = next;
   else
-  {
-    NWK_DataReq_t *prev = nwkDataReqQueue;
-    while (prev->next != req)
-      prev = prev->next;
-    prev->next = ((NWK_DataReq_t *)prev->next)->next;
-  }
+    nwkDataReqQueue = next;
+
+  if (next)
+    next->prev = prev;
 
   nwkIb.lock--;
   req->confirm(req);
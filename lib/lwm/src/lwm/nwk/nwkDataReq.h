@@ -64,13 +64,18 @@ enum
   NWK_OPT_BROADCAST_PAN_ID     = 1 << 2,
   NWK_OPT_LINK_LOCAL           = 1 << 3,
   NWK_OPT_MULTICAST            = 1 << 4,
+  NWK_OPT_BEACON               = 1 << 5,
+  NWK_OPT_RETRY_CHANNEL_ACCESS_ONLY = 1 << 6,
+  NWK_OPT_AGGREGATE            = 1 << 7,
 };
 
+// Unless the frame is secured, the payload is not copied and is sent
+// directly from the data buffer, which must stay unchanged until confirm
 typedef struct NWK_DataReq_t
 {
   // service fields
   void         *next;
-  void         *frame;
+  void         *prev;
   uint8_t      state;
 
   // request parameters
@@ -84,11 +89,14 @@ typedef struct NWK_DataReq_t
 #endif
   uint8_t      *data;
   uint8_t      size;
+  uint8_t      maxRetries; // attempts after a failed one, 0 disables the retries
+  uint16_t     backoff;    // ms before the first retry, doubled for each next one
   void         (*confirm)(struct NWK_DataReq_t *req);
 
   // confirmation parameters
   uint8_t      status;
   uint8_t      control;
+  uint8_t      retries;
 } NWK_DataReq_t;
 
 /*- Prototypes -------------------------------------------------------------*/
@@ -48,10 +48,23 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include "../sys/sysConfig.h"
 #include "../nwk/nwk.h"
 #include "../nwk/nwkFrame.h"
+#include "../nwk/nwkSecurity.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define NWK_FRAMES_AMOUNT  (NWK_BUFFERS_AMOUNT + NWK_SMALL_BUFFERS_AMOUNT)
+
+#ifdef NWK_ENABLE_SECURITY
+  #define NWK_FRAME_SMALL_MAX_PAYLOAD_SIZE \
+            (NWK_SMALL_BUFFER_SIZE - sizeof(NwkFrameHeader_t) - NWK_SECURITY_MIC_SIZE)
+#else
+  #define NWK_FRAME_SMALL_MAX_PAYLOAD_SIZE \
+            (NWK_SMALL_BUFFER_SIZE - sizeof(NwkFrameHeader_t))
+#endif
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -59,8 +72,42 @@ enum
   NWK_FRAME_STATE_FREE = 0x00,
 };
 
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+typedef union NwkFrameSmall_t
+{
+  uint8_t      frame[offsetof(NwkFrame_t, data) + NWK_SMALL_BUFFER_SIZE];
+  void         *align;
+} NwkFrameSmall_t;
+#endif
+
+/*- Prototypes -------------------------------------------------------------*/
+static bool nwkFrameClassAllowed(uint8_t trafficClass);
+static NwkFrame_t *nwkFrameByIndex(uint8_t index);
+static uint8_t nwkFrameIndex(NwkFrame_t *frame);
+static void nwkFrameDequeue(NwkFrame_t *frame);
+
 /*- Variables --------------------------------------------------------------*/
 static NwkFrame_t nwkFrameFrames[NWK_BUFFERS_AMOUNT];
+static uint8_t nwkFrameFreeList[NWK_BUFFERS_AMOUNT];
+static uint8_t nwkFrameFreeCount;
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+static NwkFrameSmall_t nwkFrameSmallFrames[NWK_SMALL_BUFFERS_AMOUNT];
+static uint8_t nwkFrameSmallFreeList[NWK_SMALL_BUFFERS_AMOUNT];
+static uint8_t nwkFrameSmallFreeCount;
+#endif
+static uint8_t nwkFrameClassUsed[NWK_FRAME_CLASSES_AMOUNT];
+static const uint8_t nwkFrameClassReserve[NWK_FRAME_CLASSES_AMOUNT] =
+{
+  NWK_BUFFERS_RX_RESERVE, NWK_BUFFERS_APP_TX_RESERVE, NWK_BUFFERS_ACK_RESERVE,
+  NWK_BUFFERS_FORWARD_RESERVE, NWK_BUFFERS_COMMAND_RESERVE,
+};
+static const uint8_t nwkFrameClassMax[NWK_FRAME_CLASSES_AMOUNT] =
+{
+  NWK_BUFFERS_RX_MAX, NWK_BUFFERS_APP_TX_MAX, NWK_BUFFERS_ACK_MAX,
+  NWK_BUFFERS_FORWARD_MAX, NWK_BUFFERS_COMMAND_MAX,
+};
+static NwkFrame_t *nwkFrameQueueHeads[NWK_FRAME_QUEUES_AMOUNT];
+static NwkFrame_t *nwkFrameQueueTails[NWK_FRAME_QUEUES_AMOUNT];
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -69,28 +116,101 @@ static NwkFrame_t nwkFrameFrames[NWK_BUFFERS_AMOUNT];
 *****************************************************************************/
 void nwkFrameInit(void)
 {
+  for (uint8_t i = 0; i < NWK_FRAMES_AMOUNT; i++)
+  {
+    NwkFrame_t *frame = nwkFrameByIndex(i);
+
+    frame->state = NWK_FRAME_STATE_FREE;
+    frame->queue = NWK_FRAME_QUEUE_NONE;
+  }
+
   for (uint8_t i = 0; i < NWK_BUFFERS_AMOUNT; i++)
-    nwkFrameFrames[i].state = NWK_FRAME_STATE_FREE;
+    nwkFrameFreeList[i] = i;
+  nwkFrameFreeCount = NWK_BUFFERS_AMOUNT;
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  for (uint8_t i = 0; i < NWK_SMALL_BUFFERS_AMOUNT; i++)
+    nwkFrameSmallFreeList[i] = i;
+  nwkFrameSmallFreeCount = NWK_SMALL_BUFFERS_AMOUNT;
+#endif
+
+  for (uint8_t i = 0; i < NWK_FRAME_CLASSES_AMOUNT; i++)
+    nwkFrameClassUsed[i] = 0;
+
+  for (uint8_t i = 0; i < NWK_FRAME_QUEUES_AMOUNT; i++)
+  {
+    nwkFrameQueueHeads[i] = NULL;
+    nwkFrameQueueTails[i] = NULL;
+  }
 }
 
 /*************************************************************************//**
-  @brief Allocates an empty frame from the buffer pool
+  @brief Allocates an empty frame from the buffer pool. Frames that fit into
+         NWK_SMALL_BUFFER_SIZE bytes are taken from the small pool first and
+         fall back to the large one when it is exhausted. The frame is
+         refused when its traffic class is at its quota or when taking it
+         would eat into the frames reserved for the other classes.
+  @param[in] trafficClass Traffic class the frame is accounted to
+  @param[in] size Largest payload size the frame will hold, not including
+             the frame header (room for the MIC is added when needed)
   @return Pointer to the frame or @c NULL if there are no free frames
 *****************************************************************************/
-NwkFrame_t *nwkFrameAlloc(void)
+NwkFrame_t *nwkFrameAlloc(uint8_t trafficClass, uint8_t size)
 {
-  for (uint8_t i = 0; i < NWK_BUFFERS_AMOUNT; i++)
+  NwkFrame_t *frame = NULL;
+  uint8_t used;
+
+  if (!nwkFrameClassAllowed(trafficClass))
+  {
+    nwkStats.allocFailures++;
+    nwkStats.classExhausted[trafficClass]++;
+    return NULL;
+  }
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (size <= NWK_FRAME_SMALL_MAX_PAYLOAD_SIZE && nwkFrameSmallFreeCount > 0)
+  {
+    frame = (NwkFrame_t *)&nwkFrameSmallFrames[nwkFrameSmallFreeList[--nwkFrameSmallFreeCount]];
+
+    used = NWK_SMALL_BUFFERS_AMOUNT - nwkFrameSmallFreeCount;
+    if (used > nwkStats.smallFramesMaxUsed)
+      nwkStats.smallFramesMaxUsed = used;
+  }
+#else
+  (void)size;
+#endif
+
+  if (NULL == frame && nwkFrameFreeCount > 0)
+  {
+    frame = &nwkFrameFrames[nwkFrameFreeList[--nwkFrameFreeCount]];
+
+    used = NWK_BUFFERS_AMOUNT - nwkFrameFreeCount;
+    if (used > nwkStats.framesMaxUsed)
+      nwkStats.framesMaxUsed = used;
+  }
+
+  if (NULL == frame)
   {
-    if (NWK_FRAME_STATE_FREE == nwkFrameFrames[i].state)
-    {
-      memset(&nwkFrameFrames[i], 0, sizeof(NwkFrame_t));
-      nwkFrameFrames[i].size = sizeof(NwkFrameHeader_t);
-      nwkFrameFrames[i].payload = nwkFrameFrames[i].data + sizeof(NwkFrameHeader_t);
-      nwkIb.lock++;
-      return &nwkFrameFrames[i];
-    }
+    nwkStats.allocFailures++;
+    nwkStats.classExhausted[trafficClass]++;
+    return NULL;
   }
-  return NULL;
+
+  frame->trafficClass = trafficClass;
+  nwkFrameClassUsed[trafficClass]++;
+
+  // The payload is always written before it is sent or read, so only the
+  // header and the control fields need to start from zero
+  memset(&frame->header, 0, sizeof(NwkFrameHeader_t));
+  memset(&frame->tx, 0, sizeof(frame->tx));
+  frame->size = sizeof(NwkFrameHeader_t);
+  frame->payload = frame->data + sizeof(NwkFrameHeader_t);
+  frame->queue = NWK_FRAME_QUEUE_NONE;
+  frame->next = NULL;
+  frame->prev = NULL;
+  nwkIb.lock++;
+
+  return frame;
 }
 
 /*************************************************************************//**
@@ -99,29 +219,131 @@ NwkFrame_t *nwkFrameAlloc(void)
 *****************************************************************************/
 void nwkFrameFree(NwkFrame_t *frame)
 {
+  uint8_t index = nwkFrameIndex(frame);
+
+  nwkFrameDequeue(frame);
   frame->state = NWK_FRAME_STATE_FREE;
+  nwkFrameClassUsed[frame->trafficClass]--;
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (index >= NWK_BUFFERS_AMOUNT)
+    nwkFrameSmallFreeList[nwkFrameSmallFreeCount++] = index - NWK_BUFFERS_AMOUNT;
+  else
+#endif
+    nwkFrameFreeList[nwkFrameFreeCount++] = index;
+
   nwkIb.lock--;
 }
 
 /*************************************************************************//**
-  @brief Cycles through the allocated frames starting from the specified @a frame
-  @param[in] frame Pointer to the current frame or @c NULL for the first frame
-  @return Next allocated frame or @c NULL if there are no more frames
+  @brief Moves a @a frame to the tail of the @a queue, removing it from the
+         queue it was in before. A frame that is already in the @a queue
+         keeps its position.
+  @param[in] queue Queue of the module that takes over the frame
+  @param[in] frame Pointer to the frame
 *****************************************************************************/
-NwkFrame_t *nwkFrameNext(NwkFrame_t *frame)
+void nwkFrameEnqueue(uint8_t queue, NwkFrame_t *frame)
 {
-  if (NULL == frame)
-    frame = nwkFrameFrames;
+  if (queue == frame->queue)
+    return;
+
+  nwkFrameDequeue(frame);
+
+  frame->queue = queue;
+  frame->next = NULL;
+  frame->prev = nwkFrameQueueTails[queue];
+
+  if (nwkFrameQueueTails[queue])
+    nwkFrameQueueTails[queue]->next = frame;
   else
-    frame++;
+    nwkFrameQueueHeads[queue] = frame;
+
+  nwkFrameQueueTails[queue] = frame;
+}
+
+/*************************************************************************//**
+  @brief Returns the first frame of the @a queue. Handlers walk the queue
+         through frame->next and must read it before processing a frame,
+         since processing may move the frame to another queue or free it.
+  @param[in] queue Queue to be inspected
+  @return Pointer to the first frame or @c NULL if the queue is empty
+*****************************************************************************/
+NwkFrame_t *nwkFrameQueueHead(uint8_t queue)
+{
+  return nwkFrameQueueHeads[queue];
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static bool nwkFrameClassAllowed(uint8_t trafficClass)
+{
+  uint8_t free = nwkFrameFreeCount;
+  uint8_t reserved = 0;
+
+  if (nwkFrameClassUsed[trafficClass] >= nwkFrameClassMax[trafficClass])
+    return false;
 
-  for (; frame < &nwkFrameFrames[NWK_BUFFERS_AMOUNT]; frame++)
+  if (nwkFrameClassUsed[trafficClass] < nwkFrameClassReserve[trafficClass])
+    return true;
+
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  free += nwkFrameSmallFreeCount;
+#endif
+
+  for (uint8_t i = 0; i < NWK_FRAME_CLASSES_AMOUNT; i++)
   {
-    if (NWK_FRAME_STATE_FREE != frame->state)
-      return frame;
+    if (nwkFrameClassUsed[i] < nwkFrameClassReserve[i])
+      reserved += nwkFrameClassReserve[i] - nwkFrameClassUsed[i];
   }
 
-  return NULL;
+  return free > reserved;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static NwkFrame_t *nwkFrameByIndex(uint8_t index)
+{
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if (index >= NWK_BUFFERS_AMOUNT)
+    return (NwkFrame_t *)&nwkFrameSmallFrames[index - NWK_BUFFERS_AMOUNT];
+#endif
+  return &nwkFrameFrames[index];
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint8_t nwkFrameIndex(NwkFrame_t *frame)
+{
+#if NWK_SMALL_BUFFERS_AMOUNT > 0
+  if ((uint8_t *)frame >= (uint8_t *)nwkFrameSmallFrames &&
+      (uint8_t *)frame < (uint8_t *)&nwkFrameSmallFrames[NWK_SMALL_BUFFERS_AMOUNT])
+    return NWK_BUFFERS_AMOUNT + ((NwkFrameSmall_t *)frame - nwkFrameSmallFrames);
+#endif
+  return frame - nwkFrameFrames;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkFrameDequeue(NwkFrame_t *frame)
+{
+  uint8_t queue = frame->queue;
+
+  if (NWK_FRAME_QUEUE_NONE == queue)
+    return;
+
+  if (frame->prev)
+    frame->prev->next = frame->next;
+  else
+    nwkFrameQueueHeads[queue] = frame->next;
+
+  if (frame->next)
+    frame->next->prev = frame->prev;
+  else
+    nwkFrameQueueTails[queue] = frame->prev;
+
+  frame->queue = NWK_FRAME_QUEUE_NONE;
+  frame->next = NULL;
+  frame->prev = NULL;
 }
 
 /*************************************************************************//**
@@ -58,6 +58,16 @@ extern "C" {
 #define NWK_FRAME_MAX_PAYLOAD_SIZE   127
 
 /*- Types ------------------------------------------------------------------*/
+enum
+{
+  NWK_FRAME_QUEUE_RX              = 0,
+  NWK_FRAME_QUEUE_TX              = 1,
+  NWK_FRAME_QUEUE_SECURITY        = 2,
+  NWK_FRAME_QUEUE_ROUTE_DISCOVERY = 3,
+  NWK_FRAME_QUEUES_AMOUNT,
+  NWK_FRAME_QUEUE_NONE            = 0xff,
+};
+
 typedef struct PACK NwkFrameHeader_t
 {
   uint16_t    macFcf;
@@ -72,7 +82,9 @@ typedef struct PACK NwkFrameHeader_t
     uint8_t   security   : 1;
     uint8_t   linkLocal  : 1;
     uint8_t   multicast  : 1;
-    uint8_t   reserved   : 4;
+    uint8_t   beacon     : 1;
+    uint8_t   aggregate  : 1;
+    uint8_t   reserved   : 2;
   }           nwkFcf;
   uint8_t     nwkSeq;
   uint16_t    nwkSrcAddr;
@@ -92,16 +104,24 @@ typedef struct PACK NwkFrameMulticastHeader_t
   uint16_t    maxMemberRadius    : 4;
 } NwkFrameMulticastHeader_t;
 
+// Precedes each payload carried in an aggregate frame
+typedef struct PACK NwkFrameAggregateRecord_t
+{
+  uint8_t     srcEndpoint : 4;
+  uint8_t     dstEndpoint : 4;
+  uint8_t     size;
+} NwkFrameAggregateRecord_t;
+
 typedef struct NwkFrame_t
 {
   uint8_t      state;
   uint8_t      size;
 
-  union
-  {
-    NwkFrameHeader_t header;
-    uint8_t          data[NWK_FRAME_MAX_PAYLOAD_SIZE];
-  };
+  // Queue of the module currently owning the frame
+  struct NwkFrame_t *next;
+  struct NwkFrame_t *prev;
+  uint8_t      queue;
+  uint8_t      trafficClass;
 
   uint8_t      *payload;
 
@@ -111,23 +131,47 @@ typedef struct NwkFrame_t
     {
       uint8_t  lqi;
       int8_t   rssi;
+      uint32_t timestamp;
     } rx;
 
     struct
     {
       uint8_t  status;
-      uint16_t timeout;
+      uint32_t timeout; // delay before sending, us
+      uint32_t due;     // time the delay or the ACK wait ends, us
+      struct NwkFrame_t *nextDue;
+      struct NwkFrame_t *prevDue;
+      struct NwkFrame_t *nextAck;
+      void     *request; // NWK_DataReq_t that owns the frame, if any
+      uint8_t  retries;  // attempts left after a failed one
+      uint8_t  retried;  // attempts made after the first one
+      uint16_t backoff;  // ms before the next attempt
+#ifdef NWK_ENABLE_AGGREGATION
+      struct NwkFrame_t *container; // aggregate frame carrying this one
+#endif
       uint8_t  control;
       void     (*confirm)(struct NwkFrame_t *frame);
+      uint8_t  *data;   // caller-owned payload sent after the frame data
+      uint8_t  size;
+      uint8_t  heard;   // copies overheard while a rebroadcast is pending
+      uint32_t ready;   // time the frame became ready to send, us
     } tx;
   };
+
+  // Must be the last field, frames from the small pool are truncated here
+  union
+  {
+    NwkFrameHeader_t header;
+    uint8_t          data[NWK_FRAME_MAX_PAYLOAD_SIZE];
+  };
 } NwkFrame_t;
 
 /*- Prototypes -------------------------------------------------------------*/
 void nwkFrameInit(void);
-NwkFrame_t *nwkFrameAlloc(void);
+NwkFrame_t *nwkFrameAlloc(uint8_t trafficClass, uint8_t size);
 void nwkFrameFree(NwkFrame_t *frame);
-NwkFrame_t *nwkFrameNext(NwkFrame_t *frame);
+void nwkFrameEnqueue(uint8_t queue, NwkFrame_t *frame);
+NwkFrame_t *nwkFrameQueueHead(uint8_t queue);
 void nwkFrameCommandInit(NwkFrame_t *frame);
 
 /*- Implementations --------------------------------------------------------*/
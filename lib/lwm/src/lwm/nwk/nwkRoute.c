@@ -320,7 +320,7 @@ static void nwkRouteSendRouteError(uint16_t src, uint16_t dst, uint8_t multicast
   NwkFrame_t *frame;
   NwkCommandRouteError_t *command;
 
-  if (NULL == (frame = nwkFrameAlloc()))
+  if (NULL == (frame = nwkFrameAlloc(NWK_FRAME_CLASS_COMMAND, sizeof(NwkCommandRouteError_t))))
     return;
 
   nwkFrameCommandInit(frame);
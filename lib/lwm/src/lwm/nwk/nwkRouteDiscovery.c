@@ -123,6 +123,7 @@ void nwkRouteDiscoveryRequest(NwkFrame_t *frame)
 
   if (entry)
   {
+    nwkFrameEnqueue(NWK_FRAME_QUEUE_ROUTE_DISCOVERY, frame);
     frame->state = NWK_RD_STATE_WAIT_FOR_ROUTE;
     return;
   }
@@ -138,6 +139,7 @@ void nwkRouteDiscoveryRequest(NwkFrame_t *frame)
 
     if (nwkRouteDiscoverySendRequest(entry, NWK_ROUTE_DISCOVERY_BEST_LINK_QUALITY))
     {
+      nwkFrameEnqueue(NWK_FRAME_QUEUE_ROUTE_DISCOVERY, frame);
       frame->state = NWK_RD_STATE_WAIT_FOR_ROUTE;
       return;
     }
@@ -225,7 +227,7 @@ static bool nwkRouteDiscoverySendRequest(NwkRouteDiscoveryTableEntry_t *entry, u
   NwkFrame_t *req;
   NwkCommandRouteRequest_t *command;
 
-  if (NULL == (req = nwkFrameAlloc()))
+  if (NULL == (req = nwkFrameAlloc(NWK_FRAME_CLASS_COMMAND, sizeof(NwkCommandRouteRequest_t))))
     return false;
 
   nwkFrameCommandInit(req);
@@ -315,7 +317,7 @@ static void nwkRouteDiscoverySendReply(NwkRouteDiscoveryTableEntry_t *entry, uin
   NwkFrame_t *req;
   NwkCommandRouteReply_t *command;
 
-  if (NULL == (req = nwkFrameAlloc()))
+  if (NULL == (req = nwkFrameAlloc(NWK_FRAME_CLASS_COMMAND, sizeof(NwkCommandRouteReply_t))))
     return;
 
   nwkFrameCommandInit(req);
@@ -376,12 +378,12 @@ bool nwkRouteDiscoveryReplyReceived(NWK_DataInd_t *ind)
 *****************************************************************************/
 static void nwkRouteDiscoveryDone(NwkRouteDiscoveryTableEntry_t *entry, bool status)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_ROUTE_DISCOVERY);
+  NwkFrame_t *next;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (; frame; frame = next)
   {
-    if (NWK_RD_STATE_WAIT_FOR_ROUTE != frame->state)
-      continue;
+    next = frame->next;
 
     if (entry->dstAddr != frame->header.nwkDstAddr ||
         entry->multicast != frame->header.nwkFcf.multicast)
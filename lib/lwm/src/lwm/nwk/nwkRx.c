@@ -62,11 +62,16 @@
 #include "../nwk/nwkRouteDiscovery.h"
 
 /*- Definitions ------------------------------------------------------------*/
-#define NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL   100 // ms
-#define DUPLICATE_REJECTION_TTL \
-            ((NWK_DUPLICATE_REJECTION_TTL / NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL) + 1)
+#define NWK_RX_DUPLICATE_REJECTION_BUCKETS \
+            (NWK_DUPLICATE_REJECTION_TABLE_SIZE / NWK_DUPLICATE_REJECTION_WAYS)
+#define NWK_RX_DUPLICATE_REJECTION_TTL \
+            ((uint32_t)NWK_DUPLICATE_REJECTION_TTL * 1000) // us
 #define NWK_SERVICE_ENDPOINT_ID    0
 
+#if NWK_DUPLICATE_REJECTION_TABLE_SIZE % NWK_DUPLICATE_REJECTION_WAYS
+  #error NWK_DUPLICATE_REJECTION_WAYS must divide NWK_DUPLICATE_REJECTION_TABLE_SIZE
+#endif
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
@@ -82,17 +87,37 @@ typedef struct NwkDuplicateRejectionEntry_t
   uint16_t src;
   uint8_t  seq;
   uint8_t  mask;
-  uint8_t  ttl;
+  uint8_t  macSeq;     // MAC sequence number the seq frame last came with
+  bool     acked;      // an ACK was sent for the seq frame
+  uint8_t  ackControl; // control value of that ACK
+  uint32_t lastSeen;   // us
 } NwkDuplicateRejectionEntry_t;
 
 /*- Prototypes -------------------------------------------------------------*/
-static void nwkRxDuplicateRejectionTimerHandler(SYS_Timer_t *timer);
 static bool nwkRxServiceDataInd(NWK_DataInd_t *ind);
+#ifdef NWK_ENABLE_BEACONS
+static void nwkRxBeaconInd(PHY_DataInd_t *ind);
+#endif
+#ifdef NWK_ENABLE_BATCH_INDICATION
+static bool nwkRxBatchAdd(NwkFrame_t *frame);
+static void nwkRxBatchFlush(void);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 static NwkDuplicateRejectionEntry_t nwkRxDuplicateRejectionTable[NWK_DUPLICATE_REJECTION_TABLE_SIZE];
+static uint16_t nwkRxDuplicateRejectionSweep;
 static uint8_t nwkRxAckControl;
-static SYS_Timer_t nwkRxDuplicateRejectionTimer;
+#ifdef NWK_ENABLE_BATCH_INDICATION
+static NwkFrame_t *nwkRxBatchFrames[NWK_BATCH_INDICATION_SIZE];
+static NWK_DataInd_t nwkRxBatchInds[NWK_BATCH_INDICATION_SIZE];
+static bool nwkRxBatchAcks[NWK_BATCH_INDICATION_SIZE];
+static uint8_t nwkRxBatchCount;
+#endif
+#ifdef NWK_ENABLE_BEACONS
+static NWK_Beacon_t nwkRxBeacons[NWK_BEACON_BUFFER_SIZE];
+static uint8_t nwkRxBeaconsHead;
+static uint8_t nwkRxBeaconsCount;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -101,12 +126,18 @@ static SYS_Timer_t nwkRxDuplicateRejectionTimer;
 *****************************************************************************/
 void nwkRxInit(void)
 {
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
-    nwkRxDuplicateRejectionTable[i].ttl = 0;
+  for (uint16_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+    nwkRxDuplicateRejectionTable[i].src = NWK_BROADCAST_ADDR;
+  nwkRxDuplicateRejectionSweep = 0;
 
-  nwkRxDuplicateRejectionTimer.interval = NWK_RX_DUPLICATE_REJECTION_TIMER_INTERVAL;
-  nwkRxDuplicateRejectionTimer.mode = SYS_TIMER_INTERVAL_MODE;
-  nwkRxDuplicateRejectionTimer.handler = nwkRxDuplicateRejectionTimerHandler;
+#ifdef NWK_ENABLE_BATCH_INDICATION
+  nwkRxBatchCount = 0;
+#endif
+
+#ifdef NWK_ENABLE_BEACONS
+  nwkRxBeaconsHead = 0;
+  nwkRxBeaconsCount = 0;
+#endif
 
   NWK_OpenEndpoint(NWK_SERVICE_ENDPOINT_ID, nwkRxServiceDataInd);
 }
@@ -115,22 +146,105 @@ void nwkRxInit(void)
 *****************************************************************************/
 void PHY_DataInd(PHY_DataInd_t *ind)
 {
+  NwkFrameHeader_t *header = (NwkFrameHeader_t *)ind->data;
   NwkFrame_t *frame;
 
+  // Everything that can be rejected from the header alone is rejected here,
+  // before a frame is allocated and the data is copied out of the radio
   if (0x88 != ind->data[1] || (0x61 != ind->data[0] && 0x41 != ind->data[0]) ||
       ind->size < sizeof(NwkFrameHeader_t))
     return;
 
-  if (NULL == (frame = nwkFrameAlloc()))
+#ifndef NWK_ENABLE_SECURITY
+  if (header->nwkFcf.security)
+    return;
+#endif
+
+#ifndef NWK_ENABLE_AGGREGATION
+  if (header->nwkFcf.aggregate)
     return;
+#endif
+
+#ifndef NWK_ENABLE_MULTICAST
+  if (header->nwkFcf.multicast)
+    return;
+#else
+  if (header->nwkFcf.multicast && header->nwkFcf.ackRequest)
+    return;
+#endif
 
+  if (header->nwkFcf.beacon)
+  {
+  #ifdef NWK_ENABLE_BEACONS
+    nwkRxBeaconInd(ind);
+  #endif
+    return;
+  }
+
+  if (NULL == (frame = nwkFrameAlloc(NWK_FRAME_CLASS_RX, ind->size - sizeof(NwkFrameHeader_t))))
+  {
+    nwkStats.rxPoolFull++;
+    return;
+  }
+
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_RX, frame);
   frame->state = NWK_RX_STATE_RECEIVED;
   frame->size = ind->size;
   frame->rx.lqi = ind->lqi;
   frame->rx.rssi = ind->rssi;
+  frame->rx.timestamp = ind->timestamp;
   memcpy(frame->data, ind->data, ind->size);
 }
 
+#ifdef NWK_ENABLE_BEACONS
+/*************************************************************************//**
+  @brief Stores a received beacon for the application. Beacons bypass the
+         frame pool, the duplicate rejection and the routing entirely.
+*****************************************************************************/
+static void nwkRxBeaconInd(PHY_DataInd_t *ind)
+{
+  NwkFrameHeader_t *header = (NwkFrameHeader_t *)ind->data;
+  uint8_t size = ind->size - sizeof(NwkFrameHeader_t);
+  NWK_Beacon_t *beacon;
+
+  if (size > NWK_BEACON_MAX_PAYLOAD_SIZE || NWK_BEACON_BUFFER_SIZE == nwkRxBeaconsCount)
+  {
+    nwkStats.beaconsDropped++;
+    return;
+  }
+
+  beacon = &nwkRxBeacons[(nwkRxBeaconsHead + nwkRxBeaconsCount) % NWK_BEACON_BUFFER_SIZE];
+  nwkRxBeaconsCount++;
+
+  beacon->srcAddr = header->nwkSrcAddr;
+  beacon->srcEndpoint = header->nwkSrcEndpoint;
+  beacon->dstEndpoint = header->nwkDstEndpoint;
+  beacon->seq = header->nwkSeq;
+  beacon->lqi = ind->lqi;
+  beacon->rssi = ind->rssi;
+  beacon->timestamp = ind->timestamp;
+  beacon->size = size;
+  memcpy(beacon->data, ind->data + sizeof(NwkFrameHeader_t), size);
+}
+
+/*************************************************************************//**
+  @brief Takes the oldest received beacon
+  @param[out] beacon Where the beacon is copied to
+  @return @c true if a beacon was available
+*****************************************************************************/
+bool NWK_GetBeacon(NWK_Beacon_t *beacon)
+{
+  if (0 == nwkRxBeaconsCount)
+    return false;
+
+  *beacon = nwkRxBeacons[nwkRxBeaconsHead];
+  nwkRxBeaconsHead = (nwkRxBeaconsHead + 1) % NWK_BEACON_BUFFER_SIZE;
+  nwkRxBeaconsCount--;
+
+  return true;
+}
+#endif // NWK_ENABLE_BEACONS
+
 /*************************************************************************//**
 *****************************************************************************/
 static void nwkRxSendAck(NwkFrame_t *frame)
@@ -138,7 +252,7 @@ static void nwkRxSendAck(NwkFrame_t *frame)
   NwkFrame_t *ack;
   NwkCommandAck_t *command;
 
-  if (NULL == (ack = nwkFrameAlloc()))
+  if (NULL == (ack = nwkFrameAlloc(NWK_FRAME_CLASS_ACK, sizeof(NwkCommandAck_t))))
     return;
 
   nwkFrameCommandInit(ack);
@@ -169,6 +283,8 @@ void NWK_SetAckControl(uint8_t control)
 *****************************************************************************/
 void nwkRxDecryptConf(NwkFrame_t *frame, bool status)
 {
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_RX, frame);
+
   if (status)
     frame->state = NWK_RX_STATE_INDICATE;
   else
@@ -178,35 +294,57 @@ void nwkRxDecryptConf(NwkFrame_t *frame, bool status)
 
 /*************************************************************************//**
 *****************************************************************************/
-static void nwkRxDuplicateRejectionTimerHandler(SYS_Timer_t *timer)
+static NwkDuplicateRejectionEntry_t *nwkRxDuplicateRejectionBucket(uint16_t src)
 {
-  bool restart = false;
+  uint16_t hash = (src ^ (src >> 8)) % NWK_RX_DUPLICATE_REJECTION_BUCKETS;
+
+  return &nwkRxDuplicateRejectionTable[hash * NWK_DUPLICATE_REJECTION_WAYS];
+}
 
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+/*************************************************************************//**
+  @brief Returns the live duplicate rejection entry of the @a src, if any
+*****************************************************************************/
+static NwkDuplicateRejectionEntry_t *nwkRxDuplicateRejectionFind(uint16_t src)
+{
+  NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateRejectionBucket(src);
+  uint32_t now = SYS_TimerNow();
+
+  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_WAYS; i++, entry++)
   {
-    if (nwkRxDuplicateRejectionTable[i].ttl)
-    {
-      nwkRxDuplicateRejectionTable[i].ttl--;
-      restart = true;
-    }
+    if (src == entry->src && (now - entry->lastSeen) < NWK_RX_DUPLICATE_REJECTION_TTL)
+      return entry;
   }
 
-  if (restart)
-    SYS_TimerStart(timer);
+  return NULL;
 }
 
 /*************************************************************************//**
+  @brief Checks the frame against the source's sequence window. Entries
+         expire lazily NWK_DUPLICATE_REJECTION_TTL after the last new
+         sequence number and are freed the next time their bucket is
+         looked at; when a bucket is full the least recently updated
+         entry is replaced.
 *****************************************************************************/
 static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
 {
-  NwkDuplicateRejectionEntry_t *entry;
-  NwkDuplicateRejectionEntry_t *freeEntry = NULL;
+  NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateRejectionBucket(header->nwkSrcAddr);
+  NwkDuplicateRejectionEntry_t *victim = NULL;
+  uint32_t victimAge = 0;
+  uint32_t now = SYS_TimerNow();
 
-  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_TABLE_SIZE; i++)
+  for (uint8_t i = 0; i < NWK_DUPLICATE_REJECTION_WAYS; i++, entry++)
   {
-    entry = &nwkRxDuplicateRejectionTable[i];
+    uint32_t age = now - entry->lastSeen;
+    bool live;
+
+    // The age of an expired entry would look small again once the timer
+    // wraps around, so the entry is freed instead of just being skipped
+    if (age >= NWK_RX_DUPLICATE_REJECTION_TTL)
+      entry->src = NWK_BROADCAST_ADDR;
 
-    if (entry->ttl && header->nwkSrcAddr == entry->src)
+    live = NWK_BROADCAST_ADDR != entry->src;
+
+    if (live && header->nwkSrcAddr == entry->src)
     {
       uint8_t diff = (int8_t)entry->seq - header->nwkSeq;
 
@@ -230,28 +368,53 @@ static bool nwkRxRejectDuplicate(NwkFrameHeader_t *header)
 
         entry->seq = header->nwkSeq;
         entry->mask = (entry->mask << shift) | 1;
-        entry->ttl = DUPLICATE_REJECTION_TTL;
+        entry->macSeq = header->macSeq;
+        entry->acked = false;
+        entry->lastSeen = now;
         return false;
       }
     }
 
-    if (0 == entry->ttl)
-      freeEntry = entry;
-  }
+    if (!live)
+      age = UINT32_MAX;
 
-  if (NULL == freeEntry)
-    return true;
+    if (NULL == victim || age > victimAge)
+    {
+      victim = entry;
+      victimAge = age;
+    }
+  }
 
-  freeEntry->src = header->nwkSrcAddr;
-  freeEntry->seq = header->nwkSeq;
-  freeEntry->mask = 1;
-  freeEntry->ttl = DUPLICATE_REJECTION_TTL;
+  if (UINT32_MAX != victimAge)
+    nwkStats.duplicateEvictions++;
 
-  SYS_TimerStart(&nwkRxDuplicateRejectionTimer);
+  victim->src = header->nwkSrcAddr;
+  victim->seq = header->nwkSeq;
+  victim->mask = 1;
+  victim->macSeq = header->macSeq;
+  victim->acked = false;
+  victim->lastSeen = now;
 
   return false;
 }
 
+/*************************************************************************//**
+  @brief Frees one expired duplicate rejection entry per call, so entries of
+         the buckets no frame hashes to are gone long before the timer wraps
+         around
+*****************************************************************************/
+static void nwkRxDuplicateRejectionExpire(void)
+{
+  NwkDuplicateRejectionEntry_t *entry = &nwkRxDuplicateRejectionTable[nwkRxDuplicateRejectionSweep];
+
+  if (NWK_BROADCAST_ADDR != entry->src &&
+      (SYS_TimerNow() - entry->lastSeen) >= NWK_RX_DUPLICATE_REJECTION_TTL)
+    entry->src = NWK_BROADCAST_ADDR;
+
+  if (++nwkRxDuplicateRejectionSweep == NWK_DUPLICATE_REJECTION_TABLE_SIZE)
+    nwkRxDuplicateRejectionSweep = 0;
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 static bool nwkRxServiceDataInd(NWK_DataInd_t *ind)
@@ -295,19 +458,6 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
 
   frame->state = NWK_RX_STATE_FINISH;
 
-#ifndef NWK_ENABLE_SECURITY
-  if (header->nwkFcf.security)
-    return;
-#endif
-
-#ifdef NWK_ENABLE_MULTICAST
-  if (header->nwkFcf.multicast && header->nwkFcf.ackRequest)
-    return;
-#else
-  if (header->nwkFcf.multicast)
-    return;
-#endif
-
   if (NWK_BROADCAST_PANID == header->macDstPanId)
   {
     if (nwkIb.addr == header->nwkDstAddr || NWK_BROADCAST_ADDR == header->nwkDstAddr)
@@ -338,7 +488,30 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
 #endif
 
   if (nwkRxRejectDuplicate(header))
+  {
+    if (NWK_BROADCAST_ADDR == header->macDstAddr)
+      nwkTxBroadcastHeard(header);
+
+    // The sender retries with the same sequence number when our ACK got
+    // lost, so acknowledge the copy again instead of dropping it silently.
+    // Only the latest frame of the source is remembered well enough for
+    // that, and a copy with the same MAC sequence number is just a MAC
+    // retransmission the transceiver has already acknowledged.
+    else if (nwkIb.addr == header->nwkDstAddr && header->nwkFcf.ackRequest &&
+        0 == header->nwkFcf.multicast && NWK_BROADCAST_ADDR != nwkIb.addr)
+    {
+      NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateRejectionFind(header->nwkSrcAddr);
+
+      if (entry && entry->acked && entry->seq == header->nwkSeq &&
+          entry->macSeq != header->macSeq)
+      {
+        entry->macSeq = header->macSeq;
+        nwkRxAckControl = entry->ackControl;
+        nwkRxSendAck(frame);
+      }
+    }
     return;
+  }
 
 #ifdef NWK_ENABLE_MULTICAST
   if (header->nwkFcf.multicast)
@@ -418,6 +591,31 @@ static void nwkRxHandleReceivedFrame(NwkFrame_t *frame)
   }
 }
 
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRxFillIndication(NwkFrame_t *frame, NWK_DataInd_t *ind)
+{
+  NwkFrameHeader_t *header = &frame->header;
+
+  ind->srcAddr = header->nwkSrcAddr;
+  ind->dstAddr = header->nwkDstAddr;
+  ind->srcEndpoint = header->nwkSrcEndpoint;
+  ind->dstEndpoint = header->nwkDstEndpoint;
+  ind->data = frame->payload;
+  ind->size = nwkFramePayloadSize(frame);
+  ind->lqi = frame->rx.lqi;
+  ind->rssi = frame->rx.rssi;
+  ind->timestamp = frame->rx.timestamp;
+
+  ind->options  = (header->nwkFcf.ackRequest) ? NWK_IND_OPT_ACK_REQUESTED : 0;
+  ind->options |= (header->nwkFcf.security) ? NWK_IND_OPT_SECURED : 0;
+  ind->options |= (header->nwkFcf.linkLocal) ? NWK_IND_OPT_LINK_LOCAL : 0;
+  ind->options |= (header->nwkFcf.multicast) ? NWK_IND_OPT_MULTICAST : 0;
+  ind->options |= (NWK_BROADCAST_ADDR == header->nwkDstAddr) ? NWK_IND_OPT_BROADCAST : 0;
+  ind->options |= (header->nwkSrcAddr == header->macSrcAddr) ? NWK_IND_OPT_LOCAL : 0;
+  ind->options |= (NWK_BROADCAST_PANID == header->macDstPanId) ? NWK_IND_OPT_BROADCAST_PAN_ID : 0;
+}
+
 /*************************************************************************//**
 *****************************************************************************/
 static bool nwkRxIndicateFrame(NwkFrame_t *frame)
@@ -428,35 +626,15 @@ static bool nwkRxIndicateFrame(NwkFrame_t *frame)
   if (NULL == nwkIb.endpoint[header->nwkDstEndpoint])
     return false;
 
-  ind.srcAddr = header->nwkSrcAddr;
-  ind.dstAddr = header->nwkDstAddr;
-  ind.srcEndpoint = header->nwkSrcEndpoint;
-  ind.dstEndpoint = header->nwkDstEndpoint;
-  ind.data = frame->payload;
-  ind.size = nwkFramePayloadSize(frame);
-  ind.lqi = frame->rx.lqi;
-  ind.rssi = frame->rx.rssi;
-
-  ind.options  = (header->nwkFcf.ackRequest) ? NWK_IND_OPT_ACK_REQUESTED : 0;
-  ind.options |= (header->nwkFcf.security) ? NWK_IND_OPT_SECURED : 0;
-  ind.options |= (header->nwkFcf.linkLocal) ? NWK_IND_OPT_LINK_LOCAL : 0;
-  ind.options |= (header->nwkFcf.multicast) ? NWK_IND_OPT_MULTICAST : 0;
-  ind.options |= (NWK_BROADCAST_ADDR == header->nwkDstAddr) ? NWK_IND_OPT_BROADCAST : 0;
-  ind.options |= (header->nwkSrcAddr == header->macSrcAddr) ? NWK_IND_OPT_LOCAL : 0;
-  ind.options |= (NWK_BROADCAST_PANID == header->macDstPanId) ? NWK_IND_OPT_BROADCAST_PAN_ID : 0;
+  nwkRxFillIndication(frame, &ind);
 
   return nwkIb.endpoint[header->nwkDstEndpoint](&ind);
 }
 
 /*************************************************************************//**
 *****************************************************************************/
-static void nwkRxHandleIndication(NwkFrame_t *frame)
+static void nwkRxIndicationDone(NwkFrame_t *frame, bool ack)
 {
-  bool ack;
-
-  nwkRxAckControl = 0;
-  ack = nwkRxIndicateFrame(frame);
-  
   if (0 == frame->header.nwkFcf.ackRequest)
     ack = false;
 
@@ -472,20 +650,141 @@ static void nwkRxHandleIndication(NwkFrame_t *frame)
     ack = false;
 
   if (ack)
+  {
+    NwkDuplicateRejectionEntry_t *entry = nwkRxDuplicateRejectionFind(frame->header.nwkSrcAddr);
+
+    // Remembered, so a retry of the frame gets the same ACK again
+    if (entry && entry->seq == frame->header.nwkSeq)
+    {
+      entry->acked = true;
+      entry->ackControl = nwkRxAckControl;
+    }
+
     nwkRxSendAck(frame);
+  }
 
   frame->state = NWK_RX_STATE_FINISH;
 }
 
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkRxHandleIndication(NwkFrame_t *frame)
+{
+  bool ack;
+
+  nwkRxAckControl = 0;
+  ack = nwkRxIndicateFrame(frame);
+
+  nwkRxIndicationDone(frame, ack);
+}
+
+#ifdef NWK_ENABLE_AGGREGATION
+/*************************************************************************//**
+  @brief Indicates every payload of an aggregate @a frame separately, as if
+         each came in its own frame. Aggregate frames are never acknowledged.
+*****************************************************************************/
+static void nwkRxHandleAggregate(NwkFrame_t *frame)
+{
+  uint8_t *data = frame->payload;
+  uint8_t *end = frame->data + frame->size;
+
+  while (data + sizeof(NwkFrameAggregateRecord_t) <= end)
+  {
+    NwkFrameAggregateRecord_t *record = (NwkFrameAggregateRecord_t *)data;
+    NWK_DataInd_t ind;
+
+    data += sizeof(NwkFrameAggregateRecord_t);
+
+    if (data + record->size > end)
+      break;
+
+    nwkRxFillIndication(frame, &ind);
+    ind.srcEndpoint = record->srcEndpoint;
+    ind.dstEndpoint = record->dstEndpoint;
+    ind.data = data;
+    ind.size = record->size;
+    data += record->size;
+
+    if (nwkIb.endpoint[ind.dstEndpoint])
+    {
+      nwkIb.endpoint[ind.dstEndpoint](&ind);
+    }
+  #ifdef NWK_ENABLE_BATCH_INDICATION
+    else if (nwkIb.batchEndpoint[ind.dstEndpoint])
+    {
+      bool ack = false;
+
+      nwkIb.batchEndpoint[ind.dstEndpoint](&ind, &ack, 1);
+    }
+  #endif
+  }
+
+  nwkRxIndicationDone(frame, false);
+}
+#endif // NWK_ENABLE_AGGREGATION
+
+#ifdef NWK_ENABLE_BATCH_INDICATION
+/*************************************************************************//**
+  @brief Adds a @a frame to the pending batch if its endpoint has a batch
+         handler. A frame that does not fit in the current batch is left
+         for the next task pass.
+  @return @c true if the frame is handled in batch mode
+*****************************************************************************/
+static bool nwkRxBatchAdd(NwkFrame_t *frame)
+{
+  uint8_t endpoint = frame->header.nwkDstEndpoint;
+
+  if (NULL == nwkIb.batchEndpoint[endpoint])
+    return false;
+
+  if (NWK_BATCH_INDICATION_SIZE == nwkRxBatchCount ||
+      (nwkRxBatchCount > 0 && endpoint != nwkRxBatchInds[0].dstEndpoint))
+    return true;
+
+  nwkRxBatchFrames[nwkRxBatchCount] = frame;
+  nwkRxBatchAcks[nwkRxBatchCount] = false;
+  nwkRxFillIndication(frame, &nwkRxBatchInds[nwkRxBatchCount]);
+  nwkRxBatchCount++;
+
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Indicates the pending batch and releases its frames
+*****************************************************************************/
+static void nwkRxBatchFlush(void)
+{
+  if (0 == nwkRxBatchCount)
+    return;
+
+  nwkRxAckControl = 0;
+  nwkIb.batchEndpoint[nwkRxBatchInds[0].dstEndpoint](nwkRxBatchInds, nwkRxBatchAcks,
+      nwkRxBatchCount);
+
+  for (uint8_t i = 0; i < nwkRxBatchCount; i++)
+  {
+    nwkRxIndicationDone(nwkRxBatchFrames[i], nwkRxBatchAcks[i]);
+    nwkFrameFree(nwkRxBatchFrames[i]);
+  }
+
+  nwkRxBatchCount = 0;
+}
+#endif // NWK_ENABLE_BATCH_INDICATION
+
 /*************************************************************************//**
   @brief Rx Module task handler
 *****************************************************************************/
 void nwkRxTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_RX);
+  NwkFrame_t *next;
+
+  nwkRxDuplicateRejectionExpire();
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (; frame; frame = next)
   {
+    next = frame->next;
+
     switch (frame->state)
     {
       case NWK_RX_STATE_RECEIVED:
@@ -502,6 +801,17 @@ void nwkRxTaskHandler(void)
 
       case NWK_RX_STATE_INDICATE:
       {
+      #ifdef NWK_ENABLE_AGGREGATION
+        if (frame->header.nwkFcf.aggregate)
+        {
+          nwkRxHandleAggregate(frame);
+          break;
+        }
+      #endif
+      #ifdef NWK_ENABLE_BATCH_INDICATION
+        if (nwkRxBatchAdd(frame))
+          break;
+      #endif
         nwkRxHandleIndication(frame);
       } break;
 
@@ -518,4 +828,8 @@ void nwkRxTaskHandler(void)
       } break;
     }
   }
+
+#ifdef NWK_ENABLE_BATCH_INDICATION
+  nwkRxBatchFlush();
+#endif
 }
@@ -52,7 +52,9 @@ extern "C" {
 
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
+#include <stdbool.h>
 #include "../sys/sysTypes.h"
+#include "../sys/sysConfig.h"
 #include "../nwk/nwkFrame.h"
 
 /*- Types ------------------------------------------------------------------*/
@@ -78,11 +80,31 @@ typedef struct NWK_DataInd_t
   uint8_t      size;
   uint8_t      lqi;
   int8_t       rssi;
+  uint32_t     timestamp; // start of the frame reception, see SYS_TimerNow(), us
 } NWK_DataInd_t;
 
+#ifdef NWK_ENABLE_BEACONS
+typedef struct NWK_Beacon_t
+{
+  uint16_t     srcAddr;
+  uint8_t      srcEndpoint;
+  uint8_t      dstEndpoint;
+  uint8_t      seq;
+  uint8_t      lqi;
+  int8_t       rssi;
+  uint32_t     timestamp; // start of the frame reception, see SYS_TimerNow(), us
+  uint8_t      size;
+  uint8_t      data[NWK_BEACON_MAX_PAYLOAD_SIZE];
+} NWK_Beacon_t;
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
 void NWK_SetAckControl(uint8_t control);
 
+#ifdef NWK_ENABLE_BEACONS
+bool NWK_GetBeacon(NWK_Beacon_t *beacon);
+#endif
+
 #ifdef NWK_ENABLE_ADDRESS_FILTER
 bool NWK_FilterAddress(uint16_t addr, uint8_t *lqi);
 #endif
@@ -98,6 +98,8 @@ void NWK_SetSecurityKey(uint8_t *key)
 *****************************************************************************/
 void nwkSecurityProcess(NwkFrame_t *frame, bool encrypt)
 {
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_SECURITY, frame);
+
   if (encrypt)
     frame->state = NWK_SECURITY_STATE_ENCRYPT_PENDING;
   else
@@ -182,7 +184,7 @@ static bool nwkSecurityProcessMic(void)
 *****************************************************************************/
 void nwkSecurityTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_SECURITY);
 
   if (0 == nwkSecurityActiveFrames)
     return;
@@ -210,7 +212,7 @@ void nwkSecurityTaskHandler(void)
     return;
   }
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (; frame; frame = frame->next)
   {
     if (NWK_SECURITY_STATE_ENCRYPT_PENDING == frame->state ||
         NWK_SECURITY_STATE_DECRYPT_PENDING == frame->state)
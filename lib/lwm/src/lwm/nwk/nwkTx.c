@@ -52,6 +52,7 @@
 #include "../phy/phy.h"
 #include "../sys/sysConfig.h"
 #include "../sys/sysTimer.h"
+#include "../sys/sysRandom.h"
 #include "../nwk/nwk.h"
 #include "../nwk/nwkTx.h"
 #include "../nwk/nwkFrame.h"
@@ -60,9 +61,7 @@
 #include "../nwk/nwkSecurity.h"
 
 /*- Definitions ------------------------------------------------------------*/
-#define NWK_TX_ACK_WAIT_TIMER_INTERVAL    50 // ms
-#define NWK_TX_DELAY_TIMER_INTERVAL       10 // ms
-#define NWK_TX_DELAY_JITTER_MASK          0x07
+#define NWK_TX_ACK_TABLE_SIZE      8
 
 /*- Types ------------------------------------------------------------------*/
 enum
@@ -75,16 +74,41 @@ enum
   NWK_TX_STATE_SENT       = 0x15,
   NWK_TX_STATE_WAIT_ACK   = 0x16,
   NWK_TX_STATE_CONFIRM    = 0x17,
+  NWK_TX_STATE_AGGREGATED = 0x18,
 };
 
 /*- Prototypes -------------------------------------------------------------*/
-static void nwkTxAckWaitTimerHandler(SYS_Timer_t *timer);
-static void nwkTxDelayTimerHandler(SYS_Timer_t *timer);
+static uint32_t nwkTxJitter(void);
+static void nwkTxDueInsert(NwkFrame_t *frame, uint32_t delay);
+static void nwkTxDueRemove(NwkFrame_t *frame);
+static void nwkTxDueTaskHandler(void);
+static void nwkTxAckWaitStart(NwkFrame_t *frame);
+static void nwkTxAckWaitStop(NwkFrame_t *frame);
+static bool nwkTxRetry(NwkFrame_t *frame, uint8_t status);
+#ifdef NWK_ENABLE_AGGREGATION
+static void nwkTxAggregate(NwkFrame_t *frame);
+static void nwkTxAggregateConf(NwkFrame_t *container);
+#endif
+static void nwkTxReady(NwkFrame_t *frame);
+static NwkFrame_t *nwkTxSelectFrame(void);
+static void nwkTxSendFrame(NwkFrame_t *frame);
 
 /*- Variables --------------------------------------------------------------*/
 static NwkFrame_t *nwkTxPhyActiveFrame;
-static SYS_Timer_t nwkTxAckWaitTimer;
-static SYS_Timer_t nwkTxDelayTimer;
+// Frames waiting for a delay or an ACK, sorted by the due time
+static NwkFrame_t *nwkTxDueList;
+// Frames waiting for an ACK, hashed by the sequence number. Sequence numbers
+// are consecutive, so the chains rarely hold more than one frame.
+static NwkFrame_t *nwkTxAckTable[NWK_TX_ACK_TABLE_SIZE];
+// Lower is sent first, unicast frames forwarded in place keep the Rx class
+static const uint8_t nwkTxClassPriority[NWK_FRAME_CLASSES_AMOUNT] =
+{
+  3, // NWK_FRAME_CLASS_RX
+  2, // NWK_FRAME_CLASS_APP_TX
+  0, // NWK_FRAME_CLASS_ACK
+  3, // NWK_FRAME_CLASS_FORWARD
+  1, // NWK_FRAME_CLASS_COMMAND
+};
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -94,14 +118,10 @@ static SYS_Timer_t nwkTxDelayTimer;
 void nwkTxInit(void)
 {
   nwkTxPhyActiveFrame = NULL;
+  nwkTxDueList = NULL;
 
-  nwkTxAckWaitTimer.interval = NWK_TX_ACK_WAIT_TIMER_INTERVAL;
-  nwkTxAckWaitTimer.mode = SYS_TIMER_INTERVAL_MODE;
-  nwkTxAckWaitTimer.handler = nwkTxAckWaitTimerHandler;
-
-  nwkTxDelayTimer.interval = NWK_TX_DELAY_TIMER_INTERVAL;
-  nwkTxDelayTimer.mode = SYS_TIMER_INTERVAL_MODE;
-  nwkTxDelayTimer.handler = nwkTxDelayTimerHandler;
+  for (uint8_t i = 0; i < NWK_TX_ACK_TABLE_SIZE; i++)
+    nwkTxAckTable[i] = NULL;
 }
 
 /*************************************************************************//**
@@ -110,6 +130,9 @@ void nwkTxFrame(NwkFrame_t *frame)
 {
   NwkFrameHeader_t *header = &frame->header;
 
+  // Route discovery may take the frame over from here
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_TX, frame);
+
   if (frame->tx.control & NWK_TX_CONTROL_ROUTING)
   {
     frame->state = NWK_TX_STATE_DELAY;
@@ -145,12 +168,17 @@ void nwkTxFrame(NwkFrame_t *frame)
   if (NWK_BROADCAST_ADDR == header->macDstAddr)
   {
     header->macFcf = 0x8841;
-    frame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+    frame->tx.timeout = nwkTxJitter();
   }
   else
   {
     header->macFcf = 0x8861;
     frame->tx.timeout = 0;
+
+  #ifdef NWK_ENABLE_AGGREGATION
+    if (frame->tx.control & NWK_TX_CONTROL_AGGREGATE)
+      frame->tx.timeout = NWK_AGGREGATION_HOLD_TIME;
+  #endif
   }
 }
 
@@ -160,13 +188,23 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
 {
   NwkFrame_t *newFrame;
 
-  if (NULL == (newFrame = nwkFrameAlloc()))
+#if NWK_BROADCAST_PROBABILITY < 100
+  if (SYS_RandomRange(0, 99) >= NWK_BROADCAST_PROBABILITY)
+  {
+    nwkStats.rebroadcastsSkipped++;
+    return;
+  }
+#endif
+
+  if (NULL == (newFrame = nwkFrameAlloc(NWK_FRAME_CLASS_FORWARD, nwkFramePayloadSize(frame))))
     return;
 
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_TX, newFrame);
   newFrame->state = NWK_TX_STATE_DELAY;
   newFrame->size = frame->size;
   newFrame->tx.status = NWK_SUCCESS_STATUS;
-  newFrame->tx.timeout = (rand() & NWK_TX_DELAY_JITTER_MASK) + 1;
+  newFrame->tx.timeout = nwkTxJitter();
+  newFrame->tx.control = NWK_TX_CONTROL_REBROADCAST;
   newFrame->tx.confirm = NULL;
   memcpy(newFrame->data, frame->data, frame->size);
 
@@ -175,6 +213,43 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
   newFrame->header.macDstPanId = frame->header.macDstPanId;
   newFrame->header.macSrcAddr = nwkIb.addr;
   newFrame->header.macSeq = ++nwkIb.macSeqNum;
+
+  nwkStats.rebroadcasts++;
+}
+
+/*************************************************************************//**
+  @brief Accounts a copy of a broadcast frame overheard from a neighbour and
+         cancels our own pending rebroadcast of it once enough copies were
+         heard during its jitter delay
+  @param[in] header Header of the overheard (duplicate) frame
+*****************************************************************************/
+void nwkTxBroadcastHeard(NwkFrameHeader_t *header)
+{
+#if NWK_BROADCAST_SUPPRESSION_THRESHOLD > 0
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_TX);
+
+  for (; frame; frame = frame->next)
+  {
+    if (0 == (frame->tx.control & NWK_TX_CONTROL_REBROADCAST) ||
+        (NWK_TX_STATE_DELAY != frame->state && NWK_TX_STATE_WAIT_DELAY != frame->state &&
+        NWK_TX_STATE_SEND != frame->state))
+      continue;
+
+    if (frame->header.nwkSrcAddr != header->nwkSrcAddr ||
+        frame->header.nwkSeq != header->nwkSeq)
+      continue;
+
+    if (++frame->tx.heard >= NWK_BROADCAST_SUPPRESSION_THRESHOLD)
+    {
+      nwkStats.rebroadcastsSuppressed++;
+      nwkTxDueRemove(frame);
+      nwkFrameFree(frame);
+    }
+    return;
+  }
+#else
+  (void)header;
+#endif
 }
 
 /*************************************************************************//**
@@ -182,15 +257,18 @@ void nwkTxBroadcastFrame(NwkFrame_t *frame)
 bool nwkTxAckReceived(NWK_DataInd_t *ind)
 {
   NwkCommandAck_t *command = (NwkCommandAck_t *)ind->data;
-  NwkFrame_t *frame = NULL;
+  NwkFrame_t *frame;
 
   if (sizeof(NwkCommandAck_t) != ind->size)
     return false;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  frame = nwkTxAckTable[command->seq % NWK_TX_ACK_TABLE_SIZE];
+
+  for (; frame; frame = frame->tx.nextAck)
   {
-    if (NWK_TX_STATE_WAIT_ACK == frame->state && frame->header.nwkSeq == command->seq)
+    if (frame->header.nwkSeq == command->seq)
     {
+      nwkTxAckWaitStop(frame);
       frame->state = NWK_TX_STATE_CONFIRM;
       frame->tx.control = command->control;
       return true;
@@ -202,63 +280,374 @@ bool nwkTxAckReceived(NWK_DataInd_t *ind)
 
 /*************************************************************************//**
 *****************************************************************************/
-static void nwkTxAckWaitTimerHandler(SYS_Timer_t *timer)
+void nwkTxConfirm(NwkFrame_t *frame, uint8_t status)
 {
-  NwkFrame_t *frame = NULL;
-  bool restart = false;
+  if (NWK_TX_STATE_WAIT_DELAY == frame->state)
+    nwkTxDueRemove(frame);
+  else if (NWK_TX_STATE_WAIT_ACK == frame->state)
+    nwkTxAckWaitStop(frame);
+
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_TX, frame);
+  frame->state = NWK_TX_STATE_CONFIRM;
+  frame->tx.status = status;
+  frame->tx.control &= ~NWK_TX_CONTROL_POLICY;
+}
+
+#ifdef NWK_ENABLE_SECURITY
+/*************************************************************************//**
+*****************************************************************************/
+void nwkTxEncryptConf(NwkFrame_t *frame)
+{
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_TX, frame);
+  frame->state = NWK_TX_STATE_DELAY;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Returns a random broadcast delay, us
+*****************************************************************************/
+static uint32_t nwkTxJitter(void)
+{
+  return SYS_RandomRange(NWK_BROADCAST_JITTER_MIN, NWK_BROADCAST_JITTER_MAX);
+}
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+/*************************************************************************//**
+  @brief Schedules the end of the current wait of the @a frame
+  @param[in] frame Pointer to the frame
+  @param[in] delay Time from now, us
+*****************************************************************************/
+static void nwkTxDueInsert(NwkFrame_t *frame, uint32_t delay)
+{
+  NwkFrame_t *prev = NULL;
+  NwkFrame_t *next = nwkTxDueList;
+
+  frame->tx.due = SYS_TimerNow() + delay;
+
+  while (next && (int32_t)(next->tx.due - frame->tx.due) <= 0)
+  {
+    prev = next;
+    next = next->tx.nextDue;
+  }
+
+  frame->tx.prevDue = prev;
+  frame->tx.nextDue = next;
+
+  if (prev)
+    prev->tx.nextDue = frame;
+  else
+    nwkTxDueList = frame;
+
+  if (next)
+    next->tx.prevDue = frame;
+}
+
+/*************************************************************************//**
+  @brief Unlinks the @a frame from the due list in constant time. Frames the
+         due task handler has already taken off the list are left alone.
+*****************************************************************************/
+static void nwkTxDueRemove(NwkFrame_t *frame)
+{
+  if (frame->tx.prevDue)
+    frame->tx.prevDue->tx.nextDue = frame->tx.nextDue;
+  else if (nwkTxDueList == frame)
+    nwkTxDueList = frame->tx.nextDue;
+  else
+    return;
+
+  if (frame->tx.nextDue)
+    frame->tx.nextDue->tx.prevDue = frame->tx.prevDue;
+
+  frame->tx.prevDue = NULL;
+  frame->tx.nextDue = NULL;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkTxAckWaitStart(NwkFrame_t *frame)
+{
+  NwkFrame_t **head = &nwkTxAckTable[frame->header.nwkSeq % NWK_TX_ACK_TABLE_SIZE];
+
+  frame->state = NWK_TX_STATE_WAIT_ACK;
+  frame->tx.nextAck = *head;
+  *head = frame;
+
+  nwkTxDueInsert(frame, NWK_ACK_WAIT_TIME * 1000UL);
+}
+
+/*************************************************************************//**
+  @brief Ends the ACK wait of the @a frame. Only the short chain of its
+         sequence number is walked; the due list is unlinked through the
+         back-link of the frame.
+*****************************************************************************/
+static void nwkTxAckWaitStop(NwkFrame_t *frame)
+{
+  NwkFrame_t **link = &nwkTxAckTable[frame->header.nwkSeq % NWK_TX_ACK_TABLE_SIZE];
+
+  for (; *link; link = &(*link)->tx.nextAck)
   {
-    if (NWK_TX_STATE_WAIT_ACK == frame->state)
+    if (*link == frame)
     {
-      restart = true;
+      *link = frame->tx.nextAck;
+      break;
+    }
+  }
 
-      if (0 == --frame->tx.timeout)
-        nwkTxConfirm(frame, NWK_NO_ACK_STATUS);
+  nwkTxDueRemove(frame);
+}
+
+/*************************************************************************//**
+  @brief Ends the waits that are due. The list is sorted, so nothing but its
+         head is looked at while no wait is due.
+*****************************************************************************/
+static void nwkTxDueTaskHandler(void)
+{
+  uint32_t now = SYS_TimerNow();
+
+  while (nwkTxDueList && (int32_t)(now - nwkTxDueList->tx.due) >= 0)
+  {
+    NwkFrame_t *frame = nwkTxDueList;
+
+    nwkTxDueList = frame->tx.nextDue;
+    if (nwkTxDueList)
+      nwkTxDueList->tx.prevDue = NULL;
+    frame->tx.nextDue = NULL;
+
+    if (NWK_TX_STATE_WAIT_DELAY == frame->state)
+    {
+    #ifdef NWK_ENABLE_AGGREGATION
+      if (frame->tx.control & NWK_TX_CONTROL_AGGREGATE)
+        nwkTxAggregate(frame);
+      else
+    #endif
+        nwkTxReady(frame);
     }
+    else if (!nwkTxRetry(frame, NWK_NO_ACK_STATUS))
+      nwkTxConfirm(frame, NWK_NO_ACK_STATUS);
   }
+}
+
+/*************************************************************************//**
+  @brief Schedules another attempt of a failed frame if its retry policy
+         allows it. The wait is the current backoff plus a random part of up
+         to the same length, and the backoff doubles after every attempt.
+  @param[in] frame Pointer to the failed frame
+  @param[in] status Reason of the failure, success is never retried
+  @return @c true if the frame will be sent again or @c false otherwise
+*****************************************************************************/
+static bool nwkTxRetry(NwkFrame_t *frame, uint8_t status)
+{
+  uint32_t backoff;
+
+  if (NWK_SUCCESS_STATUS == status || 0 == frame->tx.retries)
+    return false;
+
+  if ((frame->tx.control & NWK_TX_CONTROL_RETRY_CHANNEL_ACCESS_ONLY) &&
+      NWK_PHY_CHANNEL_ACCESS_FAILURE_STATUS != status)
+    return false;
+
+  if (NWK_TX_STATE_WAIT_ACK == frame->state)
+    nwkTxAckWaitStop(frame);
+
+  frame->tx.retries--;
+  frame->tx.retried++;
+  nwkStats.txRetries++;
+
+  backoff = frame->tx.backoff * 1000UL;
+  frame->tx.backoff = (frame->tx.backoff < 0x8000) ? frame->tx.backoff * 2 : 0xffff;
 
-  if (restart)
-    SYS_TimerStart(timer);
+  // Only the MAC sequence number changes. The network one is kept, so if the
+  // previous attempt did arrive and just its ACK was lost, the receiver
+  // rejects the copy as a duplicate and sends the ACK again.
+  frame->header.macSeq = ++nwkIb.macSeqNum;
+  frame->state = NWK_TX_STATE_WAIT_DELAY;
+  nwkTxDueInsert(frame, backoff + SYS_RandomRange(0, backoff));
+
+  return true;
 }
 
+#ifdef NWK_ENABLE_AGGREGATION
 /*************************************************************************//**
 *****************************************************************************/
-void nwkTxConfirm(NwkFrame_t *frame, uint8_t status)
+static uint8_t nwkTxAggregateRecordSize(NwkFrame_t *frame)
 {
-  frame->state = NWK_TX_STATE_CONFIRM;
-  frame->tx.status = status;
+  return sizeof(NwkFrameAggregateRecord_t) + nwkFramePayloadSize(frame) + frame->tx.size;
 }
 
-#ifdef NWK_ENABLE_SECURITY
 /*************************************************************************//**
+  @brief Checks if the @a peer may share an aggregate frame with the @a frame
 *****************************************************************************/
-void nwkTxEncryptConf(NwkFrame_t *frame)
+static bool nwkTxAggregateMatch(NwkFrame_t *frame, NwkFrame_t *peer)
 {
-  frame->state = NWK_TX_STATE_DELAY;
+  return peer != frame && (peer->tx.control & NWK_TX_CONTROL_AGGREGATE) &&
+      (NWK_TX_STATE_WAIT_DELAY == peer->state || NWK_TX_STATE_SEND == peer->state) &&
+      peer->header.nwkDstAddr == frame->header.nwkDstAddr &&
+      peer->header.macDstAddr == frame->header.macDstAddr;
+}
+
+/*************************************************************************//**
+  @brief Copies the payload of the @a frame into the @a container as a record
+*****************************************************************************/
+static void nwkTxAggregateAppend(NwkFrame_t *container, NwkFrame_t *frame)
+{
+  NwkFrameAggregateRecord_t *record = (NwkFrameAggregateRecord_t *)(container->data + container->size);
+  uint8_t *data = (uint8_t *)(record + 1);
+  uint8_t size = nwkFramePayloadSize(frame);
+
+  record->srcEndpoint = frame->header.nwkSrcEndpoint;
+  record->dstEndpoint = frame->header.nwkDstEndpoint;
+  record->size = size + frame->tx.size;
+
+  memcpy(data, frame->payload, size);
+  memcpy(data + size, frame->tx.data, frame->tx.size);
+  container->size += sizeof(NwkFrameAggregateRecord_t) + record->size;
+
+  if (NWK_TX_STATE_WAIT_DELAY == frame->state)
+    nwkTxDueRemove(frame);
+
+  frame->state = NWK_TX_STATE_AGGREGATED;
+  frame->tx.container = container;
+  nwkStats.aggregated++;
 }
-#endif
 
 /*************************************************************************//**
+  @brief Sends the @a frame, whose hold-down time is over, together with the
+         other queued frames to the same destination that fit in one frame.
+         Without such frames, or a buffer for the aggregate frame, the
+         @a frame is sent alone.
 *****************************************************************************/
-static void nwkTxDelayTimerHandler(SYS_Timer_t *timer)
+static void nwkTxAggregate(NwkFrame_t *frame)
 {
-  NwkFrame_t *frame = NULL;
-  bool restart = false;
+  NwkFrame_t *queue = nwkFrameQueueHead(NWK_FRAME_QUEUE_TX);
+  NwkFrame_t *container;
+  NwkFrame_t *peer;
+  uint8_t size = nwkTxAggregateRecordSize(frame);
+  uint8_t count = 0;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  for (peer = queue; peer; peer = peer->next)
   {
-    if (NWK_TX_STATE_WAIT_DELAY == frame->state)
+    if (nwkTxAggregateMatch(frame, peer) &&
+        size + nwkTxAggregateRecordSize(peer) <= NWK_MAX_PAYLOAD_SIZE)
     {
-      restart = true;
+      size += nwkTxAggregateRecordSize(peer);
+      count++;
+    }
+  }
+
+  if (0 == count || NULL == (container = nwkFrameAlloc(NWK_FRAME_CLASS_APP_TX, size)))
+  {
+    nwkTxReady(frame);
+    return;
+  }
+
+  container->header = frame->header;
+  container->header.macSeq = ++nwkIb.macSeqNum;
+  container->header.nwkSeq = ++nwkIb.nwkSeqNum;
+  container->header.nwkFcf.aggregate = 1;
+  container->header.nwkSrcEndpoint = 0;
+  container->header.nwkDstEndpoint = 0;
+  container->tx.confirm = nwkTxAggregateConf;
+
+  nwkTxAggregateAppend(container, frame);
+
+  // Same walk as above, so the same frames are taken
+  for (peer = queue; peer; peer = peer->next)
+  {
+    if (nwkTxAggregateMatch(frame, peer) &&
+        nwkFramePayloadSize(container) + nwkTxAggregateRecordSize(peer) <= NWK_MAX_PAYLOAD_SIZE)
+      nwkTxAggregateAppend(container, peer);
+  }
+
+  nwkFrameEnqueue(NWK_FRAME_QUEUE_TX, container);
+  container->tx.status = NWK_SUCCESS_STATUS;
+  nwkTxReady(container);
+}
+
+/*************************************************************************//**
+  @brief Passes the result of an aggregate frame on to the frames it carried
+*****************************************************************************/
+static void nwkTxAggregateConf(NwkFrame_t *container)
+{
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_TX);
+  uint8_t status = container->tx.status;
+
+  for (; frame; frame = frame->next)
+  {
+    if (NWK_TX_STATE_AGGREGATED != frame->state || container != frame->tx.container)
+      continue;
+
+    // Confirmed frames keep the pointer, so their route is not accounted for
+    // once more, it was done with the aggregate frame
+    if (nwkTxRetry(frame, status))
+      frame->tx.container = NULL;
+    else
+      nwkTxConfirm(frame, status);
+  }
 
-      if (0 == --frame->tx.timeout)
-        frame->state = NWK_TX_STATE_SEND;
+  nwkFrameFree(container);
+}
+#endif // NWK_ENABLE_AGGREGATION
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkTxReady(NwkFrame_t *frame)
+{
+  frame->state = NWK_TX_STATE_SEND;
+  frame->tx.ready = SYS_TimerNow();
+}
+
+/*************************************************************************//**
+  @brief Picks the next frame for the PHY. Frames go by the priority of
+         their traffic class and then by age, and every NWK_TX_AGING_TIME
+         spent waiting counts as one priority level, so a flood of urgent
+         frames can't hold back the others forever.
+  @return Pointer to the selected frame or @c NULL if none is ready
+*****************************************************************************/
+static NwkFrame_t *nwkTxSelectFrame(void)
+{
+  NwkFrame_t *frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_TX);
+  NwkFrame_t *selected = NULL;
+  uint32_t now = SYS_TimerNow();
+  int32_t best = 0;
+
+  for (; frame; frame = frame->next)
+  {
+    int32_t score;
+
+    if (NWK_TX_STATE_SEND != frame->state)
+      continue;
+
+    score = (int32_t)nwkTxClassPriority[frame->trafficClass] * NWK_TX_AGING_TIME * 1000L -
+        (int32_t)(now - frame->tx.ready);
+
+    if (NULL == selected || score < best)
+    {
+      selected = frame;
+      best = score;
     }
   }
 
-  if (restart)
-    SYS_TimerStart(timer);
+  return selected;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void nwkTxSendFrame(NwkFrame_t *frame)
+{
+  uint32_t ticks = (SYS_TimerNow() - frame->tx.ready) / NWK_TX_DELAY_RESOLUTION;
+  uint8_t bucket = 0;
+
+  while (ticks && bucket < NWK_TX_DELAY_HISTOGRAM_SIZE - 1)
+  {
+    ticks >>= 1;
+    bucket++;
+  }
+
+  nwkStats.txQueueDelay[frame->trafficClass][bucket]++;
+
+  nwkTxPhyActiveFrame = frame;
+  frame->state = NWK_TX_STATE_WAIT_CONF;
+  PHY_DataReqGather(frame->data, frame->size, frame->tx.data, frame->tx.size);
+  nwkIb.lock++;
 }
 
 /*************************************************************************//**
@@ -296,10 +685,15 @@ void PHY_DataConf(uint8_t status)
 *****************************************************************************/
 void nwkTxTaskHandler(void)
 {
-  NwkFrame_t *frame = NULL;
+  NwkFrame_t *frame;
+  NwkFrame_t *next;
 
-  while (NULL != (frame = nwkFrameNext(frame)))
+  nwkTxDueTaskHandler();
+
+  for (frame = nwkFrameQueueHead(NWK_FRAME_QUEUE_TX); frame; frame = next)
   {
+    next = frame->next;
+
     switch (frame->state)
     {
 #ifdef NWK_ENABLE_SECURITY
@@ -314,24 +708,16 @@ void nwkTxTaskHandler(void)
         if (frame->tx.timeout > 0)
         {
           frame->state = NWK_TX_STATE_WAIT_DELAY;
-          SYS_TimerStart(&nwkTxDelayTimer);
+          nwkTxDueInsert(frame, frame->tx.timeout);
         }
         else
         {
-          frame->state = NWK_TX_STATE_SEND;
+          nwkTxReady(frame);
         }
       } break;
 
       case NWK_TX_STATE_SEND:
-      {
-        if (NULL == nwkTxPhyActiveFrame)
-        {
-          nwkTxPhyActiveFrame = frame;
-          frame->state = NWK_TX_STATE_WAIT_CONF;
-          PHY_DataReq(frame->data, frame->size);
-          nwkIb.lock++;
-        }
-      } break;
+        break;
 
       case NWK_TX_STATE_WAIT_CONF:
         break;
@@ -342,27 +728,35 @@ void nwkTxTaskHandler(void)
         {
           if (frame->header.nwkSrcAddr == nwkIb.addr && frame->header.nwkFcf.ackRequest)
           {
-            frame->state = NWK_TX_STATE_WAIT_ACK;
-            frame->tx.timeout = NWK_ACK_WAIT_TIME / NWK_TX_ACK_WAIT_TIMER_INTERVAL + 1;
-            SYS_TimerStart(&nwkTxAckWaitTimer);
+            nwkTxAckWaitStart(frame);
           }
           else
           {
             frame->state = NWK_TX_STATE_CONFIRM;
+            frame->tx.control &= ~NWK_TX_CONTROL_POLICY;
           }
         }
-        else
+        else if (!nwkTxRetry(frame, frame->tx.status))
         {
           frame->state = NWK_TX_STATE_CONFIRM;
-	}
+          frame->tx.control &= ~NWK_TX_CONTROL_POLICY;
+        }
       } break;
 
       case NWK_TX_STATE_WAIT_ACK:
         break;
 
+#ifdef NWK_ENABLE_AGGREGATION
+      case NWK_TX_STATE_AGGREGATED:
+        break;
+#endif
+
       case NWK_TX_STATE_CONFIRM:
       {
 #ifdef NWK_ENABLE_ROUTING
+  #ifdef NWK_ENABLE_AGGREGATION
+        if (NULL == frame->tx.container)
+  #endif
         nwkRouteFrameSent(frame);
 #endif
         if (NULL == frame->tx.confirm)
@@ -375,4 +769,7 @@ void nwkTxTaskHandler(void)
         break;
     };
   }
+
+  if (NULL == nwkTxPhyActiveFrame && NULL != (frame = nwkTxSelectFrame()))
+    nwkTxSendFrame(frame);
 }
@@ -56,18 +56,28 @@ extern "C" {
 #include "../nwk/nwkRx.h"
 #include "../nwk/nwkFrame.h"
 
+/*- Definitions ------------------------------------------------------------*/
+// Send policy of the frame, cleared before the confirmation so that it does
+// not show up in the ACK control value reported to the request
+#define NWK_TX_CONTROL_POLICY \
+            (NWK_TX_CONTROL_RETRY_CHANNEL_ACCESS_ONLY | NWK_TX_CONTROL_AGGREGATE)
+
 /*- Types ------------------------------------------------------------------*/
 enum
 {
   NWK_TX_CONTROL_BROADCAST_PAN_ID = 1 << 0,
   NWK_TX_CONTROL_ROUTING          = 1 << 1,
   NWK_TX_CONTROL_DIRECT_LINK      = 1 << 2,
+  NWK_TX_CONTROL_REBROADCAST      = 1 << 3,
+  NWK_TX_CONTROL_RETRY_CHANNEL_ACCESS_ONLY = 1 << 4,
+  NWK_TX_CONTROL_AGGREGATE        = 1 << 5,
 };
 
 /*- Prototypes -------------------------------------------------------------*/
 void nwkTxInit(void);
 void nwkTxFrame(NwkFrame_t *frame);
 void nwkTxBroadcastFrame(NwkFrame_t *frame);
+void nwkTxBroadcastHeard(NwkFrameHeader_t *header);
 bool nwkTxAckReceived(NWK_DataInd_t *ind);
 void nwkTxConfirm(NwkFrame_t *frame, uint8_t status);
 void nwkTxEncryptConf(NwkFrame_t *frame);
@@ -48,15 +48,22 @@
 #ifdef PHY_ATMEGARFR2
 
 /*- Includes ---------------------------------------------------------------*/
+#include <string.h>
 #include "../sys/sysTypes.h"
 #include "../hal/hal.h"
+#include "../hal/halTimer.h"
+#include "../hal/halSleep.h"
 #include "../phy/phy.h"
 #include "atmegarfr2.h"
 
 /*- Definitions ------------------------------------------------------------*/
 #define PHY_CRC_SIZE          2
+#define PHY_MAX_FRAME_SIZE    127
 #define TRX_RPC_REG_VALUE     0xeb
 #define IRQ_CLEAR_VALUE       0xff
+#define IRQ_RX_END            (1 << 3)
+#define IRQ_TX_END            (1 << 6)
+#define PHY_SYMBOL_PERIOD     16 // us
 
 /*- Types ------------------------------------------------------------------*/
 typedef enum
@@ -67,17 +74,44 @@ typedef enum
   PHY_STATE_TX_WAIT_END,
 } PhyState_t;
 
+#if PHY_RX_BUFFERS_AMOUNT > 0
+typedef struct PhyRxBuffer_t
+{
+  uint8_t    size;
+  uint8_t    lqi;
+  int8_t     rssi;
+  uint32_t   timestamp;
+  uint8_t    data[PHY_MAX_FRAME_SIZE - PHY_CRC_SIZE];
+} PhyRxBuffer_t;
+#endif
+
 /*- Prototypes -------------------------------------------------------------*/
 static void phyTrxSetState(uint8_t state);
 static void phySetChannel(void);
 static void phySetRxState(void);
+static uint8_t phyIrqStatus(void);
+static uint32_t phyRxTimestamp(void);
+static void phyIrqClear(uint8_t irq);
+#if PHY_RX_BUFFERS_AMOUNT > 0
+static void phyRxBuffersTaskHandler(void);
+static void phyRxRelease(void);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
 static PhyState_t phyState = PHY_STATE_INITIAL;
-static uint8_t phyRxBuffer[128];
 static bool phyRxState;
 static uint8_t phyChannel;
 static uint8_t phyBand;
+#ifdef SYS_ENABLE_TICKLESS
+static volatile uint8_t phyIrqLatch;
+#endif
+#if PHY_RX_BUFFERS_AMOUNT > 0
+static PhyRxBuffer_t phyRxBuffers[PHY_RX_BUFFERS_AMOUNT];
+static volatile uint8_t phyRxBuffersHead;
+static volatile uint8_t phyRxBuffersCount;
+static volatile bool phyRxReleasePending;
+static PHY_Stats_t phyStats;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -97,6 +131,24 @@ void PHY_Init(void)
 
   TRX_CTRL_2_REG_s.rxSafeMode = 1;
 
+  // Run the symbol counter and let it latch the SFD time of received frames
+  SCCR0 |= (1 << SCEN) | (1 << SCTSE);
+
+#if PHY_RX_BUFFERS_AMOUNT > 0
+  // Received frames are copied out by the interrupt handler
+  phyRxBuffersHead = 0;
+  phyRxBuffersCount = 0;
+  phyRxReleasePending = false;
+  PHY_StatsReset();
+  IRQ_MASK_REG = IRQ_RX_END;
+#endif
+
+#ifdef SYS_ENABLE_TICKLESS
+  // Frame events must wake the MCU from idle sleep
+  phyIrqLatch = 0;
+  IRQ_MASK_REG = IRQ_RX_END | IRQ_TX_END;
+#endif
+
 #ifdef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
   CSMA_SEED_0_REG = (uint8_t)PHY_RandomReq();
 #endif
@@ -179,13 +231,31 @@ void PHY_Wakeup(void)
 *****************************************************************************/
 void PHY_DataReq(uint8_t *data, uint8_t size)
 {
+  PHY_DataReqGather(data, size, NULL, 0);
+}
+
+/*************************************************************************//**
+  @brief Sends a frame made of two segments, which are written one after the
+         other straight into the transceiver frame buffer
+  @param[in] header Pointer to the first segment
+  @param[in] headerSize Size of the first segment
+  @param[in] payload Pointer to the second segment, may be @c NULL if the
+             @a payloadSize is 0
+  @param[in] payloadSize Size of the second segment
+*****************************************************************************/
+void PHY_DataReqGather(uint8_t *header, uint8_t headerSize, uint8_t *payload, uint8_t payloadSize)
+{
+  uint8_t offset = 1;
+
   phyTrxSetState(TRX_CMD_TX_ARET_ON);
 
-  IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
+  phyIrqClear(IRQ_CLEAR_VALUE);
 
-  TRX_FRAME_BUFFER(0) = size + PHY_CRC_SIZE;
-  for (uint8_t i = 0; i < size; i++)
-    TRX_FRAME_BUFFER(i+1) = data[i];
+  TRX_FRAME_BUFFER(0) = headerSize + payloadSize + PHY_CRC_SIZE;
+  for (uint8_t i = 0; i < headerSize; i++)
+    TRX_FRAME_BUFFER(offset++) = header[i];
+  for (uint8_t i = 0; i < payloadSize; i++)
+    TRX_FRAME_BUFFER(offset++) = payload[i];
 
   phyState = PHY_STATE_TX_WAIT_END;
   TRX_STATE_REG = TRX_CMD_TX_START;
@@ -279,7 +349,7 @@ static void phySetRxState(void)
 {
   phyTrxSetState(TRX_CMD_TRX_OFF);
 
-  IRQ_STATUS_REG = IRQ_CLEAR_VALUE;
+  phyIrqClear(IRQ_CLEAR_VALUE);
 
   if (phyRxState)
     phyTrxSetState(TRX_CMD_RX_AACK_ON);
@@ -300,31 +370,49 @@ static void phyTrxSetState(uint8_t state)
 *****************************************************************************/
 void PHY_TaskHandler(void)
 {
+  uint8_t irq;
+
   if (PHY_STATE_SLEEP == phyState)
     return;
 
-  if (IRQ_STATUS_REG_s.rxEnd)
+  irq = phyIrqStatus();
+
+#if PHY_RX_BUFFERS_AMOUNT > 0
+  // The interrupt handler leaves the frame buffer protected while the
+  // automatic acknowledgement is going out
+  if (phyRxReleasePending && TRX_STATUS_BUSY_RX_AACK != TRX_STATUS_REG_s.trxStatus)
+  {
+    phyRxReleasePending = false;
+    phyRxRelease();
+  }
+
+  phyRxBuffersTaskHandler();
+
+  if (irq & IRQ_TX_END)
+#else
+  if (irq & IRQ_RX_END)
   {
     PHY_DataInd_t ind;
     uint8_t size = TST_RX_LENGTH_REG;
 
-    for (uint8_t i = 0; i < size + 1/*lqi*/; i++)
-      phyRxBuffer[i] = TRX_FRAME_BUFFER(i);
-
-    ind.data = phyRxBuffer;
+    // The frame buffer is memory mapped and stays protected by the RX safe
+    // mode until the indication returns, so it is handed out without a copy
+    ind.data = (uint8_t *)&TRX_FRAME_BUFFER(0);
     ind.size = size - PHY_CRC_SIZE;
-    ind.lqi  = phyRxBuffer[size];
+    ind.lqi  = TRX_FRAME_BUFFER(size);
     ind.rssi = (int8_t)PHY_ED_LEVEL_REG + PHY_RSSI_BASE_VAL;
+    ind.timestamp = phyRxTimestamp();
     PHY_DataInd(&ind);
 
     while (TRX_STATUS_RX_AACK_ON != TRX_STATUS_REG_s.trxStatus);
 
-    IRQ_STATUS_REG_s.rxEnd = 1;
+    phyIrqClear(IRQ_RX_END);
     TRX_CTRL_2_REG_s.rxSafeMode = 0;
     TRX_CTRL_2_REG_s.rxSafeMode = 1;
   }
 
-  else if (IRQ_STATUS_REG_s.txEnd)
+  else if (irq & IRQ_TX_END)
+#endif
   {
     if (TRX_STATUS_TX_ARET_ON == TRX_STATUS_REG_s.trxStatus)
     {
@@ -345,8 +433,177 @@ void PHY_TaskHandler(void)
       PHY_DataConf(status);
     }
 
-    IRQ_STATUS_REG_s.txEnd = 1;
+    phyIrqClear(IRQ_TX_END);
+  }
+}
+
+#if PHY_RX_BUFFERS_AMOUNT > 0
+/*************************************************************************//**
+*****************************************************************************/
+PHY_Stats_t *PHY_Stats(void)
+{
+  return &phyStats;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_StatsReset(void)
+{
+  ATOMIC_SECTION_ENTER
+    memset(&phyStats, 0, sizeof(PHY_Stats_t));
+  ATOMIC_SECTION_LEAVE
+}
+
+/*************************************************************************//**
+  @brief Indicates the frames collected by the Rx interrupt handler. Only the
+         frames present on entry are handled, so a burst can't hold the loop.
+*****************************************************************************/
+static void phyRxBuffersTaskHandler(void)
+{
+  for (uint8_t count = phyRxBuffersCount; count > 0; count--)
+  {
+    PhyRxBuffer_t *buffer = &phyRxBuffers[phyRxBuffersHead];
+    PHY_DataInd_t ind;
+
+    ind.data = buffer->data;
+    ind.size = buffer->size;
+    ind.lqi = buffer->lqi;
+    ind.rssi = buffer->rssi;
+    ind.timestamp = buffer->timestamp;
+    PHY_DataInd(&ind);
+
+    // The interrupt handler finds the free buffer from both values
+    ATOMIC_SECTION_ENTER
+      phyRxBuffersHead = (phyRxBuffersHead + 1) % PHY_RX_BUFFERS_AMOUNT;
+      phyRxBuffersCount--;
+    ATOMIC_SECTION_LEAVE
+  }
+}
+
+/*************************************************************************//**
+  @brief Lets the transceiver overwrite the frame buffer with the next frame
+*****************************************************************************/
+static void phyRxRelease(void)
+{
+  TRX_CTRL_2_REG_s.rxSafeMode = 0;
+  TRX_CTRL_2_REG_s.rxSafeMode = 1;
+}
+#endif
+
+/*************************************************************************//**
+  @brief Converts the SFD time latched by the symbol counter into the system
+         time base by subtracting its age from the current time
+*****************************************************************************/
+static uint32_t phyRxTimestamp(void)
+{
+  uint32_t now = halTimerMicros;
+  uint32_t counter, stamp;
+
+  // Reading the low byte latches the upper ones
+  counter = SCCNTLL;
+  counter |= (uint32_t)SCCNTLH << 8;
+  counter |= (uint32_t)SCCNTHL << 16;
+  counter |= (uint32_t)SCCNTHH << 24;
+
+  stamp = SCTSRLL;
+  stamp |= (uint32_t)SCTSRLH << 8;
+  stamp |= (uint32_t)SCTSRHL << 16;
+  stamp |= (uint32_t)SCTSRHH << 24;
+
+  return now - (counter - stamp) * PHY_SYMBOL_PERIOD;
+}
+
+/*************************************************************************//**
+  @brief Returns the pending transceiver events, including the ones latched
+         by the interrupt handlers
+*****************************************************************************/
+static uint8_t phyIrqStatus(void)
+{
+#ifdef SYS_ENABLE_TICKLESS
+  return IRQ_STATUS_REG | phyIrqLatch;
+#else
+  return IRQ_STATUS_REG;
+#endif
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void phyIrqClear(uint8_t irq)
+{
+  IRQ_STATUS_REG = irq;
+
+#ifdef SYS_ENABLE_TICKLESS
+  ATOMIC_SECTION_ENTER
+    phyIrqLatch &= ~irq;
+  ATOMIC_SECTION_LEAVE
+#endif
+}
+
+#if PHY_RX_BUFFERS_AMOUNT > 0
+/*************************************************************************//**
+  @brief Copies the received frame into a free Rx buffer, so the transceiver
+         can take the next one before the loop gets to PHY_TaskHandler()
+*****************************************************************************/
+ISR(TRX24_RX_END_vect)
+{
+  uint8_t size = TST_RX_LENGTH_REG;
+
+#ifdef SYS_ENABLE_TICKLESS
+  // Brings the time base up to date before the frame is timestamped
+  HAL_SleepWakeup();
+#endif
+
+  if (size < PHY_CRC_SIZE || size > PHY_MAX_FRAME_SIZE)
+  {
+    phyStats.rxMalformed++;
   }
+  else if (PHY_RX_BUFFERS_AMOUNT == phyRxBuffersCount)
+  {
+    phyStats.rxOverruns++;
+  }
+  else
+  {
+    PhyRxBuffer_t *buffer = &phyRxBuffers[(phyRxBuffersHead + phyRxBuffersCount) % PHY_RX_BUFFERS_AMOUNT];
+
+    buffer->size = size - PHY_CRC_SIZE;
+    buffer->lqi = TRX_FRAME_BUFFER(size);
+    buffer->rssi = (int8_t)PHY_ED_LEVEL_REG + PHY_RSSI_BASE_VAL;
+    buffer->timestamp = phyRxTimestamp();
+    memcpy(buffer->data, (uint8_t *)&TRX_FRAME_BUFFER(0), buffer->size);
+    phyRxBuffersCount++;
+  }
+
+  // Waiting here for the automatic acknowledgement would keep the interrupts
+  // off for the whole turnaround, and forever if the main context is just
+  // changing the transceiver state, so PHY_TaskHandler() releases the buffer
+  // once the acknowledgement is out
+  if (TRX_STATUS_BUSY_RX_AACK == TRX_STATUS_REG_s.trxStatus)
+    phyRxReleasePending = true;
+  else
+    phyRxRelease();
 }
+#endif
+
+#ifdef SYS_ENABLE_TICKLESS
+#if PHY_RX_BUFFERS_AMOUNT == 0
+/*************************************************************************//**
+  @brief The status flags are cleared when the vector is executed, so they
+         are latched here for PHY_TaskHandler()
+*****************************************************************************/
+ISR(TRX24_RX_END_vect)
+{
+  phyIrqLatch |= IRQ_RX_END;
+  HAL_SleepWakeup();
+}
+#endif
+
+/*************************************************************************//**
+*****************************************************************************/
+ISR(TRX24_TX_END_vect)
+{
+  phyIrqLatch |= IRQ_TX_END;
+  HAL_SleepWakeup();
+}
+#endif
 
 #endif // PHY_ATMEGARFR2
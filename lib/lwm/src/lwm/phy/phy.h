@@ -62,14 +62,25 @@ extern "C" {
 #define PHY_HAS_AES_MODULE
 
 /*- Types ------------------------------------------------------------------*/
+// The data points into the transceiver frame buffer, or into one of the Rx
+// buffers, and is only valid until PHY_DataInd() returns
 typedef struct PHY_DataInd_t
 {
   uint8_t    *data;
   uint8_t    size;
   uint8_t    lqi;
   int8_t     rssi;
+  uint32_t   timestamp; // start of the frame (SFD), system time base, us
 } PHY_DataInd_t;
 
+#if PHY_RX_BUFFERS_AMOUNT > 0
+typedef struct PHY_Stats_t
+{
+  uint16_t   rxOverruns;  // frames lost because all the Rx buffers were busy
+  uint16_t   rxMalformed; // frames dropped for an impossible length
+} PHY_Stats_t;
+#endif
+
 enum
 {
   PHY_STATUS_SUCCESS                = 0,
@@ -89,10 +100,16 @@ void PHY_SetTxPower(uint8_t txPower);
 void PHY_Sleep(void);
 void PHY_Wakeup(void);
 void PHY_DataReq(uint8_t *data, uint8_t size);
+void PHY_DataReqGather(uint8_t *header, uint8_t headerSize, uint8_t *payload, uint8_t payloadSize);
 void PHY_DataConf(uint8_t status);
 void PHY_DataInd(PHY_DataInd_t *ind);
 void PHY_TaskHandler(void);
 
+#if PHY_RX_BUFFERS_AMOUNT > 0
+PHY_Stats_t *PHY_Stats(void);
+void PHY_StatsReset(void);
+#endif
+
 #ifdef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
 uint16_t PHY_RandomReq(void);
 #endif
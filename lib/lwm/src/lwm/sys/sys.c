@@ -49,8 +49,11 @@
 #include "../phy/phy.h"
 #include "../nwk/nwk.h"
 #include "../hal/hal.h"
+#include "../hal/halSleep.h"
 #include "../sys/sys.h"
 #include "../sys/sysTimer.h"
+#include "../sys/sysMonitor.h"
+#include "../sys/sysRandom.h"
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -61,14 +64,54 @@ void SYS_Init(void)
   HAL_Init();
   SYS_TimerInit();
   PHY_Init();
+  SYS_RandomInit();
   NWK_Init();
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorInit();
+#endif
+#ifdef SYS_ENABLE_TICKLESS
+  HAL_SleepInit();
+#endif
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TaskHandler(void)
 {
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorStage(SYS_MONITOR_STAGE_PHY);
+#endif
   PHY_TaskHandler();
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorStage(SYS_MONITOR_STAGE_NWK);
+#endif
   NWK_TaskHandler();
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorStage(SYS_MONITOR_STAGE_TIMER);
+#endif
   SYS_TimerTaskHandler();
 }
+
+#ifdef SYS_ENABLE_TICKLESS
+/*************************************************************************//**
+  @brief Sleeps until the next timer deadline or a radio event, unless the
+         network layer has work in progress
+*****************************************************************************/
+void SYS_IdleSleep(void)
+{
+  uint32_t deadline;
+
+  if (NWK_Busy())
+    return;
+
+  deadline = SYS_TimerNextDeadline();
+  if (0 == deadline)
+    return;
+
+  HAL_IdleSleep(deadline);
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorLoopStart();
+#endif
+}
+#endif
@@ -59,6 +59,9 @@ extern "C" {
 /*- Prototypes -------------------------------------------------------------*/
 void SYS_Init(void);
 void SYS_TaskHandler(void);
+#ifdef SYS_ENABLE_TICKLESS
+void SYS_IdleSleep(void);
+#endif
 
 #endif // _SYS_H_
 #ifdef __cplusplus
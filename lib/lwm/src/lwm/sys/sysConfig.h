@@ -54,18 +54,114 @@ extern "C" {
 #include "../../../config.h"
 
 /*- Definitions ------------------------------------------------------------*/
+// Received frames copied out of the transceiver by the interrupt handler and
+// waiting for the network layer; 0 hands the frame buffer over directly
+#ifndef PHY_RX_BUFFERS_AMOUNT
+#define PHY_RX_BUFFERS_AMOUNT                    0
+#endif
+
 #ifndef NWK_BUFFERS_AMOUNT
 #define NWK_BUFFERS_AMOUNT                       5
 #endif
 
+#ifndef NWK_SMALL_BUFFERS_AMOUNT
+#define NWK_SMALL_BUFFERS_AMOUNT                 0
+#endif
+
+#ifndef NWK_SMALL_BUFFER_SIZE
+#define NWK_SMALL_BUFFER_SIZE                    32 // bytes, including the headers
+#endif
+
+// Frames guaranteed to each traffic class and the most it may hold at once
+#ifndef NWK_BUFFERS_RX_RESERVE
+#define NWK_BUFFERS_RX_RESERVE                   0
+#endif
+
+#ifndef NWK_BUFFERS_RX_MAX
+#define NWK_BUFFERS_RX_MAX                       0xff // no limit
+#endif
+
+#ifndef NWK_BUFFERS_APP_TX_RESERVE
+#define NWK_BUFFERS_APP_TX_RESERVE               0
+#endif
+
+#ifndef NWK_BUFFERS_APP_TX_MAX
+#define NWK_BUFFERS_APP_TX_MAX                   0xff
+#endif
+
+#ifndef NWK_BUFFERS_ACK_RESERVE
+#define NWK_BUFFERS_ACK_RESERVE                  0
+#endif
+
+#ifndef NWK_BUFFERS_ACK_MAX
+#define NWK_BUFFERS_ACK_MAX                      0xff
+#endif
+
+#ifndef NWK_BUFFERS_FORWARD_RESERVE
+#define NWK_BUFFERS_FORWARD_RESERVE              0
+#endif
+
+#ifndef NWK_BUFFERS_FORWARD_MAX
+#define NWK_BUFFERS_FORWARD_MAX                  0xff
+#endif
+
+#ifndef NWK_BUFFERS_COMMAND_RESERVE
+#define NWK_BUFFERS_COMMAND_RESERVE              0
+#endif
+
+#ifndef NWK_BUFFERS_COMMAND_MAX
+#define NWK_BUFFERS_COMMAND_MAX                  0xff
+#endif
+
 #ifndef NWK_DUPLICATE_REJECTION_TABLE_SIZE
 #define NWK_DUPLICATE_REJECTION_TABLE_SIZE       10
 #endif
 
+// Entries per hash bucket, must divide NWK_DUPLICATE_REJECTION_TABLE_SIZE
+#ifndef NWK_DUPLICATE_REJECTION_WAYS
+#define NWK_DUPLICATE_REJECTION_WAYS             2
+#endif
+
 #ifndef NWK_DUPLICATE_REJECTION_TTL
 #define NWK_DUPLICATE_REJECTION_TTL              1000 // ms
 #endif
 
+// Pending rebroadcasts are cancelled after overhearing this many copies of
+// the frame during their jitter delay (0 disables the suppression)
+#ifndef NWK_BROADCAST_SUPPRESSION_THRESHOLD
+#define NWK_BROADCAST_SUPPRESSION_THRESHOLD      0
+#endif
+
+#ifndef NWK_BROADCAST_PROBABILITY
+#define NWK_BROADCAST_PROBABILITY                100 // %
+#endif
+
+// Random delay before a broadcast is sent, drawn from [MIN, MAX]
+#ifndef NWK_BROADCAST_JITTER_MIN
+#define NWK_BROADCAST_JITTER_MIN                 10000 // us
+#endif
+
+#ifndef NWK_BROADCAST_JITTER_MAX
+#define NWK_BROADCAST_JITTER_MAX                 80000 // us
+#endif
+
+#ifndef NWK_BEACON_BUFFER_SIZE
+#define NWK_BEACON_BUFFER_SIZE                   4
+#endif
+
+#ifndef NWK_BEACON_MAX_PAYLOAD_SIZE
+#define NWK_BEACON_MAX_PAYLOAD_SIZE              8
+#endif
+
+#ifndef NWK_BATCH_INDICATION_SIZE
+#define NWK_BATCH_INDICATION_SIZE                4
+#endif
+
+// Time a frame waits for others to the same destination to share its frame
+#ifndef NWK_AGGREGATION_HOLD_TIME
+#define NWK_AGGREGATION_HOLD_TIME                5000 // us
+#endif
+
 #ifndef NWK_ROUTE_TABLE_SIZE
 #define NWK_ROUTE_TABLE_SIZE                     10
 #endif
@@ -78,6 +174,15 @@ extern "C" {
 #define NWK_ACK_WAIT_TIME                        1000 // ms
 #endif
 
+// Waiting this long to be sent raises a frame by one priority level
+#ifndef NWK_TX_AGING_TIME
+#define NWK_TX_AGING_TIME                        10 // ms
+#endif
+
+#ifndef NWK_TX_DELAY_RESOLUTION
+#define NWK_TX_DELAY_RESOLUTION                  500 // us
+#endif
+
 #ifndef NWK_GROUPS_AMOUNT
 #define NWK_GROUPS_AMOUNT                        10
 #endif
@@ -95,6 +200,21 @@ extern "C" {
 //#define NWK_ENABLE_MULTICAST
 //#define NWK_ENABLE_ROUTE_DISCOVERY
 //#define NWK_ENABLE_SECURE_COMMANDS
+//#define NWK_ENABLE_BEACONS
+//#define NWK_ENABLE_BATCH_INDICATION
+//#define NWK_ENABLE_AGGREGATION
+//#define SYS_ENABLE_LOOP_MONITOR
+//#define SYS_ENABLE_TIMER_STATS
+//#define SYS_ENABLE_TIMER_WHEEL
+//#define SYS_ENABLE_TICKLESS
+
+#ifndef SYS_LOOP_MONITOR_BUDGET
+#define SYS_LOOP_MONITOR_BUDGET                  2000 // us
+#endif
+
+#ifndef SYS_LOOP_MONITOR_RESOLUTION
+#define SYS_LOOP_MONITOR_RESOLUTION              16 // us
+#endif
 
 #ifndef SYS_SECURITY_MODE
 #define SYS_SECURITY_MODE                        0
@@ -0,0 +1,174 @@
+/**
+ * \file sysMonitor.c
+ *
+ * \brief Main loop latency monitor implementation
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../hal/hal.h"
+#include "../hal/halTimer.h"
+#include "../sys/sysConfig.h"
+#include "../sys/sysTimer.h"
+#include "../sys/sysMonitor.h"
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+
+/*- Prototypes -------------------------------------------------------------*/
+static void sysMonitorCloseStage(uint32_t now);
+
+/*- Variables --------------------------------------------------------------*/
+static SYS_MonitorStats_t sysMonitorStats;
+static SYS_MonitorRecord_t sysMonitorCurrent;
+static uint32_t sysMonitorIterationStart;
+static uint32_t sysMonitorStageStart;
+static uint8_t sysMonitorActiveStage;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Initializes the loop monitor
+*****************************************************************************/
+void SYS_MonitorInit(void)
+{
+  SYS_MonitorReset();
+}
+
+/*************************************************************************//**
+  @brief Clears the statistics and restarts the current iteration, so the
+         time spent dumping them is not accounted to the loop
+*****************************************************************************/
+void SYS_MonitorReset(void)
+{
+  memset(&sysMonitorStats, 0, sizeof(SYS_MonitorStats_t));
+  SYS_MonitorLoopStart();
+}
+
+/*************************************************************************//**
+  @brief Marks the beginning of the @a stage in the current iteration
+  @param[in] stage Stage that is about to run
+*****************************************************************************/
+void SYS_MonitorStage(uint8_t stage)
+{
+  sysMonitorCloseStage(halTimerMicros);
+  sysMonitorActiveStage = stage;
+}
+
+/*************************************************************************//**
+  @brief Accounts a timer @a handler execution to the current iteration
+  @param[in] handler Handler that was executed
+  @param[in] time Execution time of the handler, us
+*****************************************************************************/
+void SYS_MonitorTimerHandler(void (*handler)(SYS_Timer_t *timer), uint32_t time)
+{
+  if (time < sysMonitorCurrent.handlerTime)
+    return;
+
+  sysMonitorCurrent.handlerTime = time;
+  sysMonitorCurrent.handler = handler;
+}
+
+/*************************************************************************//**
+  @brief Closes the current iteration and starts a new one
+*****************************************************************************/
+void SYS_MonitorLoopEnd(void)
+{
+  uint32_t now = halTimerMicros;
+  uint32_t ticks;
+  uint8_t bucket = 0;
+
+  sysMonitorCloseStage(now);
+  sysMonitorCurrent.time = now - sysMonitorIterationStart;
+
+  ticks = sysMonitorCurrent.time / SYS_LOOP_MONITOR_RESOLUTION;
+  while (ticks && bucket < SYS_LOOP_MONITOR_HISTOGRAM_SIZE - 1)
+  {
+    ticks >>= 1;
+    bucket++;
+  }
+
+  sysMonitorStats.iterations++;
+  sysMonitorStats.histogram[bucket]++;
+
+  if (sysMonitorCurrent.time > SYS_LOOP_MONITOR_BUDGET)
+  {
+    sysMonitorStats.overBudget++;
+    sysMonitorStats.lastOverBudget = sysMonitorCurrent;
+  }
+
+  if (sysMonitorCurrent.time > sysMonitorStats.worst.time)
+    sysMonitorStats.worst = sysMonitorCurrent;
+
+  SYS_MonitorLoopStart();
+}
+
+/*************************************************************************//**
+  @brief Estimates a percentile of the iteration time from the histogram
+  @param[in] percent Percentile to estimate (0-100)
+  @return Upper bound of the histogram bucket containing the percentile, us,
+          or 0 if there is no data or the @a percent is out of range
+*****************************************************************************/
+uint32_t SYS_MonitorPercentile(uint8_t percent)
+{
+  uint32_t iterations = sysMonitorStats.iterations;
+  uint32_t threshold;
+  uint32_t count = 0;
+
+  if (0 == iterations || percent > 100)
+    return 0;
+
+  // Rank of the percentile, ceil(iterations * percent / 100) without
+  // overflowing 32 bits
+  threshold = (iterations / 100) * percent + ((iterations % 100) * percent + 99) / 100;
+
+  for (uint8_t i = 0; i < SYS_LOOP_MONITOR_HISTOGRAM_SIZE - 1; i++)
+  {
+    count += sysMonitorStats.histogram[i];
+    if (count >= threshold)
+      return (uint32_t)SYS_LOOP_MONITOR_RESOLUTION << i;
+  }
+
+  return sysMonitorStats.worst.time;
+}
+
+/*************************************************************************//**
+  @brief Returns the statistics collected since the last reset
+*****************************************************************************/
+SYS_MonitorStats_t *SYS_MonitorStats(void)
+{
+  return &sysMonitorStats;
+}
+
+/*************************************************************************//**
+  @brief Starts a new iteration, discarding the time elapsed since the end
+         of the previous one (e.g. while sleeping)
+*****************************************************************************/
+void SYS_MonitorLoopStart(void)
+{
+  uint32_t now = halTimerMicros;
+
+  memset(&sysMonitorCurrent, 0, sizeof(SYS_MonitorRecord_t));
+  sysMonitorIterationStart = now;
+  sysMonitorStageStart = now;
+  sysMonitorActiveStage = SYS_MONITOR_STAGE_NONE;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void sysMonitorCloseStage(uint32_t now)
+{
+  uint32_t time = now - sysMonitorStageStart;
+
+  if (time >= sysMonitorCurrent.stageTime)
+  {
+    sysMonitorCurrent.stageTime = time;
+    sysMonitorCurrent.stage = sysMonitorActiveStage;
+  }
+
+  sysMonitorStageStart = now;
+}
+
+#endif // SYS_ENABLE_LOOP_MONITOR
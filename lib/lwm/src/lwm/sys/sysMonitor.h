@@ -0,0 +1,74 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * \file sysMonitor.h
+ *
+ * \brief Main loop latency monitor interface
+ *
+ * Measures the duration of every main loop iteration and keeps a
+ * logarithmic histogram of it, together with the stage and the timer
+ * handler that were running in the slowest iterations. A single slow
+ * iteration is enough to lose a frame in the PHY, so the over-budget
+ * records are what to look at first in a counters dump.
+ *
+ */
+
+#ifndef _SYS_MONITOR_H_
+#define _SYS_MONITOR_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+#include "../sys/sysConfig.h"
+#include "../sys/sysTimer.h"
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+
+/*- Definitions ------------------------------------------------------------*/
+#define SYS_LOOP_MONITOR_HISTOGRAM_SIZE    16
+
+/*- Types ------------------------------------------------------------------*/
+typedef enum SYS_MonitorStage_t
+{
+  SYS_MONITOR_STAGE_NONE,
+  SYS_MONITOR_STAGE_PHY,
+  SYS_MONITOR_STAGE_NWK,
+  SYS_MONITOR_STAGE_TIMER,
+  SYS_MONITOR_STAGE_APP,
+} SYS_MonitorStage_t;
+
+typedef struct SYS_MonitorRecord_t
+{
+  uint32_t     time;         // iteration duration, us
+  uint32_t     stageTime;    // duration of the slowest stage, us
+  uint8_t      stage;        // slowest stage
+  uint32_t     handlerTime;  // duration of the slowest timer handler, us
+  void         (*handler)(SYS_Timer_t *timer);
+} SYS_MonitorRecord_t;
+
+typedef struct SYS_MonitorStats_t
+{
+  uint32_t            iterations;
+  uint32_t            overBudget;
+  uint32_t            histogram[SYS_LOOP_MONITOR_HISTOGRAM_SIZE];
+  SYS_MonitorRecord_t worst;
+  SYS_MonitorRecord_t lastOverBudget;
+} SYS_MonitorStats_t;
+
+/*- Prototypes -------------------------------------------------------------*/
+void SYS_MonitorInit(void);
+void SYS_MonitorReset(void);
+void SYS_MonitorStage(uint8_t stage);
+void SYS_MonitorTimerHandler(void (*handler)(SYS_Timer_t *timer), uint32_t time);
+void SYS_MonitorLoopEnd(void);
+void SYS_MonitorLoopStart(void);
+uint32_t SYS_MonitorPercentile(uint8_t percent);
+SYS_MonitorStats_t *SYS_MonitorStats(void);
+
+#endif // SYS_ENABLE_LOOP_MONITOR
+
+#endif // _SYS_MONITOR_H_
+#ifdef __cplusplus
+}
+#endif
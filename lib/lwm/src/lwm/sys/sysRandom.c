@@ -0,0 +1,79 @@
+/**
+ * \file sysRandom.c
+ *
+ * \brief Pseudo-random number generator implementation
+ *
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include "../phy/phy.h"
+#include "../sys/sysConfig.h"
+#include "../sys/sysRandom.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SYS_RANDOM_DEFAULT_STATE    2463534242UL
+
+/*- Variables --------------------------------------------------------------*/
+static uint32_t sysRandomState = SYS_RANDOM_DEFAULT_STATE;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+  @brief Seeds the generator from the transceiver, must be called after
+         PHY_Init(). Without the random number generator the state is only
+         changed by SYS_RandomSeed().
+*****************************************************************************/
+void SYS_RandomInit(void)
+{
+#ifdef PHY_ENABLE_RANDOM_NUMBER_GENERATOR
+  SYS_RandomSeed(((uint32_t)PHY_RandomReq() << 16) | PHY_RandomReq());
+#endif
+}
+
+/*************************************************************************//**
+  @brief Mixes the @a seed into the generator state
+  @param[in] seed Value that differs between the nodes
+*****************************************************************************/
+void SYS_RandomSeed(uint32_t seed)
+{
+  sysRandomState ^= seed;
+
+  // The all-zero state would repeat forever
+  if (0 == sysRandomState)
+    sysRandomState = SYS_RANDOM_DEFAULT_STATE;
+}
+
+/*************************************************************************//**
+  @brief Returns the next 32-bit pseudo-random value
+*****************************************************************************/
+uint32_t SYS_Random(void)
+{
+  uint32_t x = sysRandomState;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+
+  return sysRandomState = x;
+}
+
+/*************************************************************************//**
+  @brief Returns a pseudo-random value from @a min to @a max, inclusive.
+         The value is scaled with a multiplication, AVR has no divider for
+         a modulus. Ranges of up to 256 values use 16 random bits and a
+         16x16 multiply, the bias stays below 0.4 %.
+*****************************************************************************/
+uint32_t SYS_RandomRange(uint32_t min, uint32_t max)
+{
+  uint32_t span = max - min;
+
+  if (span <= UINT8_MAX)
+  {
+    uint16_t value = SYS_Random() >> 16;
+
+    return min + (((uint32_t)value * (uint16_t)(span + 1)) >> 16);
+  }
+
+  return min + (uint32_t)(((uint64_t)SYS_Random() * ((uint64_t)span + 1)) >> 32);
+}
@@ -0,0 +1,31 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * \file sysRandom.h
+ *
+ * \brief Pseudo-random number generator interface
+ *
+ * Xorshift32 generator for the jitter and the backoff delays. It is seeded
+ * from the transceiver true random number generator when it is enabled, so
+ * nodes that boot together still draw different delays.
+ *
+ */
+
+#ifndef _SYS_RANDOM_H_
+#define _SYS_RANDOM_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include "../sys/sysConfig.h"
+
+/*- Prototypes -------------------------------------------------------------*/
+void SYS_RandomInit(void);
+void SYS_RandomSeed(uint32_t seed);
+uint32_t SYS_Random(void);
+uint32_t SYS_RandomRange(uint32_t min, uint32_t max);
+
+#endif // _SYS_RANDOM_H_
+#ifdef __cplusplus
+}
+#endif
@@ -49,12 +49,42 @@
 #include "../hal/hal.h"
 #include "../hal/halTimer.h"
 #include "../sys/sysTimer.h"
+#include "../sys/sysMonitor.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#ifdef SYS_ENABLE_TIMER_WHEEL
+#define SYS_TIMER_WHEEL_BITS       6
+#define SYS_TIMER_WHEEL_SIZE       (1 << SYS_TIMER_WHEEL_BITS)
+#define SYS_TIMER_WHEEL_MASK       (SYS_TIMER_WHEEL_SIZE - 1)
+#define SYS_TIMER_WHEEL_LEVELS     3
+#define SYS_TIMER_WHEEL_RANGE      (1ul << (SYS_TIMER_WHEEL_BITS * SYS_TIMER_WHEEL_LEVELS))
+#define SYS_TIMER_WHEEL_TICK       1000ul // us
+#endif
 
 /*- Prototypes -------------------------------------------------------------*/
 static void placeTimer(SYS_Timer_t *timer);
+static void sysTimerRearm(SYS_Timer_t *timer);
+static void sysTimerFire(SYS_Timer_t *timer);
+static uint32_t sysTimerInterval(SYS_Timer_t *timer);
+#ifdef SYS_ENABLE_TIMER_WHEEL
+static void sysTimerWheelInsert(SYS_Timer_t *timer);
+static void sysTimerWheelRemove(SYS_Timer_t *timer);
+static void sysTimerWheelCascade(uint8_t level);
+#endif
 
 /*- Variables --------------------------------------------------------------*/
+#ifdef SYS_ENABLE_TIMER_WHEEL
+static SYS_Timer_t *sysTimerWheel[SYS_TIMER_WHEEL_LEVELS * SYS_TIMER_WHEEL_SIZE];
+static uint32_t sysTimerWheelTime;
+static uint32_t sysTimerWheelPrev;
+static uint16_t sysTimerWheelCount;
+#else
 static SYS_Timer_t *timers;
+static uint32_t sysTimerPrev;
+#endif
+#ifdef SYS_ENABLE_TIMER_STATS
+static SYS_Timer_t *sysTimerStatsList;
+#endif
 
 /*- Implementations --------------------------------------------------------*/
 
@@ -62,92 +92,404 @@ static SYS_Timer_t *timers;
 *****************************************************************************/
 void SYS_TimerInit(void)
 {
+#ifdef SYS_ENABLE_TIMER_WHEEL
+  for (uint16_t i = 0; i < SYS_TIMER_WHEEL_LEVELS * SYS_TIMER_WHEEL_SIZE; i++)
+    sysTimerWheel[i] = NULL;
+  sysTimerWheelTime = 0;
+  sysTimerWheelPrev = SYS_TimerNow();
+  sysTimerWheelCount = 0;
+#else
   timers = NULL;
+  sysTimerPrev = SYS_TimerNow();
+#endif
+#ifdef SYS_ENABLE_TIMER_STATS
+  sysTimerStatsList = NULL;
+#endif
+}
+
+/*************************************************************************//**
+  @brief Returns the monotonic time base used by the timers
+  @return Time in us; it wraps around every ~71 minutes, so only differences
+          between two values are meaningful
+*****************************************************************************/
+uint32_t SYS_TimerNow(void)
+{
+  return halTimerMicros;
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TimerStart(SYS_Timer_t *timer)
 {
+#ifdef SYS_ENABLE_TIMER_STATS
+  if (!timer->stats.registered)
+  {
+    timer->stats.registered = true;
+    timer->stats.next = sysTimerStatsList;
+    sysTimerStatsList = timer;
+  }
+#endif
+
   if (!SYS_TimerStarted(timer))
+  {
+    timer->deadline = SYS_TimerNow() + sysTimerInterval(timer);
     placeTimer(timer);
+  }
 }
 
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TimerStop(SYS_Timer_t *timer)
 {
-  SYS_Timer_t *prev = NULL;
+  if (!timer->started)
+    return;
+
+#ifdef SYS_ENABLE_TIMER_WHEEL
+  sysTimerWheelRemove(timer);
+#else
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    timers = timer->next;
 
-  for (SYS_Timer_t *t = timers; t; t = t->next)
+  if (timer->next)
   {
-    if (t == timer)
+    timer->next->prev = timer->prev;
+    timer->next->timeout += timer->timeout;
+  }
+#endif
+
+  timer->started = false;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+bool SYS_TimerStarted(SYS_Timer_t *timer)
+{
+  return timer->started;
+}
+
+#ifdef SYS_ENABLE_TIMER_WHEEL
+/*************************************************************************//**
+*****************************************************************************/
+void SYS_TimerTaskHandler(void)
+{
+  uint32_t now = SYS_TimerNow();
+
+  if (0 == sysTimerWheelCount)
+  {
+    uint32_t ticks = (now - sysTimerWheelPrev) / SYS_TIMER_WHEEL_TICK;
+
+    sysTimerWheelTime += ticks;
+    sysTimerWheelPrev += ticks * SYS_TIMER_WHEEL_TICK;
+    return;
+  }
+
+  while ((now - sysTimerWheelPrev) >= SYS_TIMER_WHEEL_TICK)
+  {
+    uint8_t index;
+
+    sysTimerWheelTime++;
+    sysTimerWheelPrev += SYS_TIMER_WHEEL_TICK;
+    index = sysTimerWheelTime & SYS_TIMER_WHEEL_MASK;
+
+    // Bring the timers of the next upper level slot down, once every
+    // full turn of the lower level
+    if (0 == index)
+      sysTimerWheelCascade(1);
+
+    while (sysTimerWheel[index])
     {
-      if (prev)
-        prev->next = t->next;
-      else
-        timers = t->next;
+      SYS_Timer_t *timer = sysTimerWheel[index];
 
-      if (t->next)
-        t->next->timeout += timer->timeout;
+      sysTimerWheelRemove(timer);
+      timer->started = false;
 
-      break;
+#ifdef SYS_ENABLE_TIMER_STATS
+      uint32_t lateness = now - timer->deadline;
+
+      timer->stats.fired++;
+      timer->stats.lateness += lateness;
+      if (lateness > timer->stats.maxLateness)
+        timer->stats.maxLateness = lateness;
+#endif
+
+      if (SYS_TIMER_INTERVAL_MODE != timer->mode)
+        sysTimerRearm(timer);
+
+      sysTimerFire(timer);
     }
-    prev = t;
+
+    if (0 == sysTimerWheelCount)
+      break;
   }
 }
 
 /*************************************************************************//**
+  @brief Returns the time left until the first pending timer expires
+  @return Time in us, 0 if a timer is already due or SYS_TIMER_NO_DEADLINE
+          if no timers are pending
+
+  Only the first level is scanned; when it is empty the next cascade is
+  reported, so the wheel may ask to be processed before the first timer
+  is actually due.
 *****************************************************************************/
-bool SYS_TimerStarted(SYS_Timer_t *timer)
+uint32_t SYS_TimerNextDeadline(void)
 {
-  for (SYS_Timer_t *t = timers; t; t = t->next)
-    if (t == timer)
-      return true;
-  return false;
+  uint32_t elapsed;
+
+  if (0 == sysTimerWheelCount)
+    return SYS_TIMER_NO_DEADLINE;
+
+  elapsed = SYS_TimerNow() - sysTimerWheelPrev;
+  if (elapsed >= SYS_TIMER_WHEEL_TICK)
+    return 0;
+
+  for (uint8_t i = 1; i < SYS_TIMER_WHEEL_SIZE; i++)
+  {
+    uint8_t index = (sysTimerWheelTime + i) & SYS_TIMER_WHEEL_MASK;
+
+    if (sysTimerWheel[index] || 0 == index)
+      return i * SYS_TIMER_WHEEL_TICK - elapsed;
+  }
+
+  return SYS_TIMER_WHEEL_SIZE * SYS_TIMER_WHEEL_TICK - elapsed;
 }
 
+#else // SYS_ENABLE_TIMER_WHEEL
+
 /*************************************************************************//**
 *****************************************************************************/
 void SYS_TimerTaskHandler(void)
 {
   uint32_t elapsed;
-  static uint8_t prev;
-  uint8_t new;
+  uint32_t now = SYS_TimerNow();
 
-  if (halTimerIrqCount == prev)
+  if (now == sysTimerPrev)
     return;
 
-  new = halTimerIrqCount;
-  // note that this uint8_t cast is needed since subtraction performs
-  // "integral promotion", which convers new and prev to (signed) int,
-  // making the result a signed int as well.
-  elapsed = (uint8_t)(new - prev) * HAL_TIMER_INTERVAL;
-  prev = new;
+  // Unsigned subtraction keeps this correct across the wrap around of
+  // the time base
+  elapsed = now - sysTimerPrev;
 
   while (timers && (timers->timeout <= elapsed))
   {
     SYS_Timer_t *timer = timers;
 
+    // Keep the list reference on the expiration being processed, so that
+    // timers placed from here are relative to the right point in time
     elapsed -= timers->timeout;
+    sysTimerPrev += timers->timeout;
     timers = timers->next;
-    if (SYS_TIMER_PERIODIC_MODE == timer->mode)
-      placeTimer(timer);
-    timer->handler(timer);
+    if (timers)
+      timers->prev = NULL;
+    timer->started = false;
+
+#ifdef SYS_ENABLE_TIMER_STATS
+    uint32_t lateness = now - timer->deadline;
+
+    timer->stats.fired++;
+    timer->stats.lateness += lateness;
+    if (lateness > timer->stats.maxLateness)
+      timer->stats.maxLateness = lateness;
+#endif
+
+    if (SYS_TIMER_INTERVAL_MODE != timer->mode)
+      sysTimerRearm(timer);
+
+    sysTimerFire(timer);
   }
 
   if (timers)
     timers->timeout -= elapsed;
+  sysTimerPrev = now;
+}
+
+/*************************************************************************//**
+  @brief Returns the time left until the first pending timer expires
+  @return Time in us, 0 if a timer is already due or SYS_TIMER_NO_DEADLINE
+          if no timers are pending
+*****************************************************************************/
+uint32_t SYS_TimerNextDeadline(void)
+{
+  uint32_t elapsed;
+
+  if (NULL == timers)
+    return SYS_TIMER_NO_DEADLINE;
+
+  elapsed = SYS_TimerNow() - sysTimerPrev;
+
+  if (timers->timeout <= elapsed)
+    return 0;
+
+  return timers->timeout - elapsed;
+}
+
+#endif // SYS_ENABLE_TIMER_WHEEL
+
+#ifdef SYS_ENABLE_TIMER_STATS
+/*************************************************************************//**
+  @brief Cycles through the timers that have been started at least once
+  @param[in] timer Pointer to the current timer or @c NULL for the first timer
+  @return Next timer or @c NULL if there are no more timers
+*****************************************************************************/
+SYS_Timer_t *SYS_TimerStatsNext(SYS_Timer_t *timer)
+{
+  if (NULL == timer)
+    return sysTimerStatsList;
+  return timer->stats.next;
+}
+
+/*************************************************************************//**
+  @brief Clears the statistics of all known timers
+*****************************************************************************/
+void SYS_TimerStatsReset(void)
+{
+  for (SYS_Timer_t *t = sysTimerStatsList; t; t = t->stats.next)
+  {
+    t->stats.fired = 0;
+    t->stats.lateness = 0;
+    t->stats.maxLateness = 0;
+    t->stats.time = 0;
+    t->stats.maxTime = 0;
+  }
 }
+#endif
 
+/*************************************************************************//**
+*****************************************************************************/
+static void sysTimerFire(SYS_Timer_t *timer)
+{
+#if defined(SYS_ENABLE_LOOP_MONITOR) || defined(SYS_ENABLE_TIMER_STATS)
+  void (*handler)(SYS_Timer_t *timer) = timer->handler;
+  uint32_t start = halTimerMicros;
+  uint32_t time;
+
+  handler(timer);
+  time = halTimerMicros - start;
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+  SYS_MonitorTimerHandler(handler, time);
+#endif
+
+#ifdef SYS_ENABLE_TIMER_STATS
+  timer->stats.time += time;
+  if (time > timer->stats.maxTime)
+    timer->stats.maxTime = time;
+#endif
+
+#else
+  timer->handler(timer);
+#endif
+}
+
+
+#ifdef SYS_ENABLE_TIMER_WHEEL
 /*************************************************************************//**
 *****************************************************************************/
 static void placeTimer(SYS_Timer_t *timer)
 {
+  // Expire on the first tick at or after the deadline
+  uint32_t time = timer->deadline - sysTimerWheelPrev;
+  uint32_t ticks;
+
+  if ((int32_t)time < 0)
+    time = 0;
+
+  ticks = (time + SYS_TIMER_WHEEL_TICK - 1) / SYS_TIMER_WHEEL_TICK;
+
+  // A zero interval would land in the slot that has just been processed
+  timer->timeout = sysTimerWheelTime + (ticks ? ticks : 1);
+  sysTimerWheelInsert(timer);
+  sysTimerWheelCount++;
+  timer->started = true;
+}
+
+/*************************************************************************//**
+  @brief Links the @a timer into the slot matching its expiration tick
+*****************************************************************************/
+static void sysTimerWheelInsert(SYS_Timer_t *timer)
+{
+  uint32_t expires = timer->timeout;
+  uint32_t delta = expires - sysTimerWheelTime;
+  uint8_t level;
+
+  if (delta < SYS_TIMER_WHEEL_SIZE)
+    level = 0;
+  else if (delta < (1ul << (SYS_TIMER_WHEEL_BITS * 2)))
+    level = 1;
+  else
+  {
+    // Timers beyond the range of the wheel are parked in the furthest slot
+    // and placed again when it cascades
+    if (delta >= SYS_TIMER_WHEEL_RANGE)
+      expires = sysTimerWheelTime + SYS_TIMER_WHEEL_RANGE - 1;
+    level = 2;
+  }
+
+  timer->slot = level * SYS_TIMER_WHEEL_SIZE +
+      ((expires >> (SYS_TIMER_WHEEL_BITS * level)) & SYS_TIMER_WHEEL_MASK);
+
+  timer->prev = NULL;
+  timer->next = sysTimerWheel[timer->slot];
+  if (timer->next)
+    timer->next->prev = timer;
+  sysTimerWheel[timer->slot] = timer;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void sysTimerWheelRemove(SYS_Timer_t *timer)
+{
+  if (timer->prev)
+    timer->prev->next = timer->next;
+  else
+    sysTimerWheel[timer->slot] = timer->next;
+
+  if (timer->next)
+    timer->next->prev = timer->prev;
+
+  sysTimerWheelCount--;
+}
+
+/*************************************************************************//**
+  @brief Moves the timers of the current slot of the @a level one level down
+*****************************************************************************/
+static void sysTimerWheelCascade(uint8_t level)
+{
+  uint8_t index = (sysTimerWheelTime >> (SYS_TIMER_WHEEL_BITS * level)) &
+      SYS_TIMER_WHEEL_MASK;
+  SYS_Timer_t *timer = sysTimerWheel[level * SYS_TIMER_WHEEL_SIZE + index];
+
+  sysTimerWheel[level * SYS_TIMER_WHEEL_SIZE + index] = NULL;
+
+  while (timer)
+  {
+    SYS_Timer_t *next = timer->next;
+
+    sysTimerWheelInsert(timer);
+    timer = next;
+  }
+
+  if (0 == index && level < SYS_TIMER_WHEEL_LEVELS - 1)
+    sysTimerWheelCascade(level + 1);
+}
+
+#else // SYS_ENABLE_TIMER_WHEEL
+
+/*************************************************************************//**
+*****************************************************************************/
+static void placeTimer(SYS_Timer_t *timer)
+{
+  // The list is relative to the last task handler run
+  uint32_t timeout = timer->deadline - sysTimerPrev;
+
+  if ((int32_t)timeout < 0)
+    timeout = 0;
+
   if (timers)
   {
     SYS_Timer_t *prev = NULL;
-    uint32_t timeout = timer->interval;
 
     for (SYS_Timer_t *t = timers; t; t = t->next)
     {
@@ -163,6 +505,7 @@ static void placeTimer(SYS_Timer_t *timer)
     }
 
     timer->timeout = timeout;
+    timer->prev = prev;
 
     if (prev)
     {
@@ -174,11 +517,61 @@ static void placeTimer(SYS_Timer_t *timer)
       timer->next = timers;
       timers = timer;
     }
+
+    if (timer->next)
+      timer->next->prev = timer;
   }
   else
   {
     timer->next = NULL;
-    timer->timeout = timer->interval;
+    timer->prev = NULL;
+    timer->timeout = timeout;
     timers = timer;
   }
+
+  timer->started = true;
+}
+#endif // SYS_ENABLE_TIMER_WHEEL
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint32_t sysTimerInterval(SYS_Timer_t *timer)
+{
+  return timer->interval * 1000ul + timer->intervalUs;
+}
+
+/*************************************************************************//**
+  @brief Schedules the next expiration of a periodic @a timer that has just
+         expired
+*****************************************************************************/
+static void sysTimerRearm(SYS_Timer_t *timer)
+{
+  uint32_t now = SYS_TimerNow();
+  uint32_t interval = sysTimerInterval(timer);
+
+  if (0 == interval)
+  {
+    timer->deadline = now;
+  }
+  else
+  {
+    timer->deadline += interval;
+
+    // Legacy periodic timers keep their phase and fire the passed deadlines
+    // late without counting them, as they did before the deadline modes
+    if (SYS_TIMER_PERIODIC_MODE != timer->mode && (int32_t)(now - timer->deadline) > 0)
+    {
+      if (SYS_TIMER_PERIODIC_SKIP_MODE == timer->mode)
+      {
+        uint32_t skipped = (now - timer->deadline) / interval + 1;
+
+        timer->deadline += skipped * interval;
+        timer->missed += skipped;
+      }
+      else
+        timer->missed++;
+    }
+  }
+
+  placeTimer(timer);
 }
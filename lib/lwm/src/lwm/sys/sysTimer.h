@@ -53,22 +53,62 @@ extern "C" {
 /*- Includes ---------------------------------------------------------------*/
 #include <stdint.h>
 #include <stdbool.h>
+#include "../sys/sysConfig.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SYS_TIMER_NO_DEADLINE      0xffffffff
 
 /*- Types ------------------------------------------------------------------*/
 typedef enum SYS_TimerMode_t
 {
   SYS_TIMER_INTERVAL_MODE,
   SYS_TIMER_PERIODIC_MODE,
+  // Periodic against absolute deadlines, so lateness does not accumulate.
+  // Deadlines that have already passed are fired late (catch up) or
+  // dropped (skip); either way they are counted in missed.
+  SYS_TIMER_PERIODIC_CATCH_UP_MODE,
+  SYS_TIMER_PERIODIC_SKIP_MODE,
 } SYS_TimerMode_t;
 
+#ifdef SYS_ENABLE_TIMER_STATS
+typedef struct SYS_TimerStats_t
+{
+  struct SYS_Timer_t   *next;
+  bool                 registered;
+  uint32_t             fired;
+  uint32_t             lateness;     // accumulated, us
+  uint32_t             maxLateness;  // us
+  uint32_t             time;         // accumulated handler time, us
+  uint32_t             maxTime;      // us
+} SYS_TimerStats_t;
+#endif
+
+// Timers must be zero-initialized before the first SYS_TimerStart() call,
+// which is always the case for static and global variables. With the timing
+// wheel backend the timeout holds the absolute expiration tick instead of
+// the delta from the previous timer. Timeouts are in us; the interval of
+// a timer is interval * 1000 + intervalUs and must stay below ~71 minutes.
 typedef struct SYS_Timer_t
 {
   // Internal data
   struct SYS_Timer_t   *next;
+  struct SYS_Timer_t   *prev;
   uint32_t             timeout;
+  uint32_t             deadline;     // absolute, us
+  bool                 started;
+#ifdef SYS_ENABLE_TIMER_WHEEL
+  uint8_t              slot;
+#endif
+#ifdef SYS_ENABLE_TIMER_STATS
+  SYS_TimerStats_t     stats;
+#endif
+
+  // Timer status
+  uint32_t             missed;
 
   // Timer parameters
-  uint32_t             interval;
+  uint32_t             interval;     // ms
+  uint32_t             intervalUs;   // added to the interval, us
   SYS_TimerMode_t      mode;
   void                 (*handler)(struct SYS_Timer_t *timer);
 } SYS_Timer_t;
@@ -79,6 +119,13 @@ void SYS_TimerStart(SYS_Timer_t *timer);
 void SYS_TimerStop(SYS_Timer_t *timer);
 bool SYS_TimerStarted(SYS_Timer_t *timer);
 void SYS_TimerTaskHandler(void);
+uint32_t SYS_TimerNextDeadline(void);
+uint32_t SYS_TimerNow(void);
+
+#ifdef SYS_ENABLE_TIMER_STATS
+SYS_Timer_t *SYS_TimerStatsNext(SYS_Timer_t *timer);
+void SYS_TimerStatsReset(void);
+#endif
 
 #endif // _SYS_TIMER_H_
 #ifdef __cplusplus
@@ -15,9 +15,16 @@
 #define PING_PERIOD 50
 #define SEND_EVERY_N_PINGS 10
 
+// Periodo di stampa delle statistiche (ms)
+#define STATS_DUMP_PERIOD 10000
+
 #define PING_ENDPOINT 1
 #define REPORT_ENDPOINT 2
 
+// Ritrasmissioni dei report in caso di errore e attesa prima della prima (ms)
+#define REPORT_MAX_RETRIES 3
+#define REPORT_RETRY_BACKOFF 10
+
 // #define DEBUG_ANCHOR
 // #define DEBUG_COORD
 
@@ -2,11 +2,18 @@
 #include <lwm/sys/sysTimer.h>
 #include <lwm/nwk/nwkTx.h>
 #include <lwm/sys/sys.h>
+#include <lwm/sys/sysMonitor.h>
+#include <lwm/hal/halSleep.h>
 #include <QueueArray.h>
 #include <HashMap.h>
 
 #include "config.h"
 
+#if defined(SYS_ENABLE_LOOP_MONITOR) || defined(SYS_ENABLE_TIMER_STATS) || \
+    defined(SYS_ENABLE_TICKLESS)
+#define STATS_DUMP
+#endif
+
 /**
  * Le ancore inviano in broadcast dei messaggi di ping.
  *
@@ -90,6 +97,14 @@ static void APP_Init (void);
  */
 static void ping_timer_handler (SYS_Timer_t *timer);
 
+#ifdef STATS_DUMP
+/**
+ * Esecutore, temporizzato, della stampa delle statistiche
+ * @param timer Software timer che richiede la stampa
+ */
+static void stats_timer_handler (SYS_Timer_t *timer);
+#endif
+
 /***********************************************************************
  *
  *      NETWORKING HEADERS
@@ -113,6 +128,14 @@ static void anchor_tx_report ();
  */
 static void anchor_tx_ping_confirmation (NWK_DataReq_t *req);
 
+#ifdef NWK_ENABLE_BEACONS
+/**
+ * Consegna i beacon ricevuti all'handler dell'endpoint di destinazione,
+ * come se fossero arrivati dal normale percorso dati
+ */
+static void rx_beacons (void);
+#endif
+
 /**
  * Alla conferma del corretto invio di un report, esegue le
  * operazioni du pulizia sull richiesta
@@ -188,6 +211,42 @@ static void print_info_boot (void);
  */
 static void debug_print_dataind_summary (NWK_DataInd_t *ind);
 
+#ifdef STATS_DUMP
+/**
+ * Stampa in seriale tutte le statistiche disponibili, poi le azzera
+ */
+static void print_stats (void);
+
+/**
+ * Stampa in seriale i contatori del network layer, poi li azzera
+ */
+static void print_nwk_stats (void);
+#endif
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+/**
+ * Stampa in seriale le statistiche di latenza del main loop raccolte
+ * dall'ultima stampa, poi le azzera
+ */
+static void print_loop_monitor (void);
+#endif
+
+#ifdef SYS_ENABLE_TIMER_STATS
+/**
+ * Stampa in seriale le statistiche di ogni software timer raccolte
+ * dall'ultima stampa, poi le azzera
+ */
+static void print_timer_stats (void);
+#endif
+
+#ifdef SYS_ENABLE_TICKLESS
+/**
+ * Stampa in seriale il tempo passato in sleep, il numero di risvegli e
+ * la loro latenza dall'ultima stampa, poi li azzera
+ */
+static void print_sleep_stats (void);
+#endif
+
 /**
  * Ottiene l'hex digest di un array di byte e lo salva in una stringa
  * @param dest Stringa di destinazione per il digest (va allocata
@@ -234,6 +293,12 @@ static uint8_t broadcast_ping_msg[PING_MSG_SIZE];
 static uint8_t report_msg[REPORT_MSG_SIZE];
 // Software timer per lo scheduling del ping
 static SYS_Timer_t ping_timer;
+#ifdef STATS_DUMP
+// Software timer per la stampa delle statistiche
+static SYS_Timer_t stats_timer;
+// Quando è true vuol dire che ci sono statistiche da stampare
+static bool stats_dump_ready = false;
+#endif
 // Coda di messaggi in uscita
 static QueueArray<NWK_DataReq_t *> outcoming_datareqs;
 // Quando è true vuol dire che c'è un NWK_DataReq in uscita che sta
@@ -241,6 +306,9 @@ static QueueArray<NWK_DataReq_t *> outcoming_datareqs;
 static bool request_busy = false;
 // Quando è true vuol dire che c'è un report da inviare
 static bool report_ready_to_send = false;
+// Quando è true il report_msg è in trasmissione: lo stack lo spedisce
+// senza copiarlo, quindi non va toccato fino alla conferma
+static bool report_in_flight = false;
 // Array grezzo di report
 static HashType<uint16_t, NodeReport_t *> report_hash_raw_array[NODES_COUNT];
 // Hashmap di report
@@ -250,7 +318,7 @@ static HashMap<uint16_t, NodeReport_t *> report_hashmap = HashMap<uint16_t, Node
 // evitano le perdite di memoria
 static char debug_message_formatted[120], debug_message_body[30];
 // Output seriale
-static char serial_output_buffer[70];
+static char serial_output_buffer[96];
 // Per motivi di performance, sprintf disabilità il placeholder %f.
 // Serve un buffer di conversione intermedio
 static char float_conversion_buffer[10];
@@ -272,7 +340,18 @@ void setup () {
 
 void loop () {
     SYS_TaskHandler();
+    #ifdef SYS_ENABLE_LOOP_MONITOR
+    SYS_MonitorStage(SYS_MONITOR_STAGE_APP);
+    #endif
     APP_TaskHandler();
+    #ifdef SYS_ENABLE_LOOP_MONITOR
+    SYS_MonitorLoopEnd();
+    #endif
+    #ifdef SYS_ENABLE_TICKLESS
+    // Dorme fino alla prossima scadenza di un timer o fino a un evento
+    // della radio
+    SYS_IdleSleep();
+    #endif
 }
 
 /***********************************************************************
@@ -290,7 +369,19 @@ static void APP_TaskHandler (void) {
         }
             break;
 
-        case APP_STATE_IDLE:
+        case APP_STATE_IDLE: {
+            #ifdef NWK_ENABLE_BEACONS
+            rx_beacons();
+            #endif
+            #ifdef STATS_DUMP
+            // La stampa è fuori dal timer handler, così non viene
+            // attribuita al timer nelle statistiche
+            if (stats_dump_ready) {
+                stats_dump_ready = false;
+                print_stats();
+            }
+            #endif
+        }
             break;
 
         default:
@@ -304,6 +395,13 @@ static void APP_Init (void) {
     PHY_SetChannel(0x1a);
     PHY_SetRxState(true);
 
+    #ifdef STATS_DUMP
+    stats_timer.interval = STATS_DUMP_PERIOD;
+    stats_timer.mode = SYS_TIMER_PERIODIC_MODE;
+    stats_timer.handler = stats_timer_handler;
+    SYS_TimerStart(&stats_timer);
+    #endif
+
     #if DONGLE_ADDRESS == COORDINATOR_ADDRESS
 
     // Endpoint di ricezione del ping al coordinator
@@ -317,7 +415,9 @@ static void APP_Init (void) {
 
     if (!SYS_TimerStarted(&ping_timer)) {
         ping_timer.interval = PING_PERIOD;
-        ping_timer.mode = SYS_TIMER_PERIODIC_MODE;
+        // Scadenze assolute: la cadenza dei ping resta in fase anche se
+        // un giro del loop è lento, i ping persi vengono saltati
+        ping_timer.mode = SYS_TIMER_PERIODIC_SKIP_MODE;
         ping_timer.handler = ping_timer_handler;
         SYS_TimerStart(&ping_timer);
     }
@@ -330,6 +430,13 @@ static void ping_timer_handler (SYS_Timer_t *timer) {
     (void) timer;
 }
 
+#ifdef STATS_DUMP
+static void stats_timer_handler (SYS_Timer_t *timer) {
+    stats_dump_ready = true;
+    (void) timer;
+}
+#endif
+
 /***********************************************************************
  *
  *      NETWORKING DEFINITIONS
@@ -357,10 +464,22 @@ static void anchor_tx_ping () {
     outcoming_msg->dstAddr = NWK_BROADCAST_ADDR;
     outcoming_msg->dstEndpoint = PING_ENDPOINT;
     outcoming_msg->srcEndpoint = 1;
+    #ifdef NWK_ENABLE_BEACONS
+    // Il ping serve solo a misurare l'RSSI sul singolo hop: come beacon
+    // non viene ritrasmesso e chi lo riceve non occupa frame dello stack.
+    // Si assume che ogni ancora sia nel raggio di almeno un'altra ancora:
+    // il coordinator sente direttamente solo le ancore vicine, quelle
+    // lontane gli arrivano attraverso i report, che restano multi-hop
+    outcoming_msg->options = NWK_OPT_BEACON;
+    #else
     outcoming_msg->options = 0;
+    #endif
     outcoming_msg->confirm = anchor_tx_ping_confirmation;
     outcoming_msg->data = broadcast_ping_msg;
     outcoming_msg->size = PING_MSG_SIZE;
+    // Un ping perso è sostituito dal successivo
+    outcoming_msg->maxRetries = 0;
+    outcoming_msg->backoff = 0;
 
     #ifdef DEBUG_ANCHOR
     debug_bytes_to_hex_digest(serial_output_buffer, outcoming_msg->data,
@@ -394,6 +513,9 @@ static void anchor_tx_report () {
     outcoming_msg->confirm = anchor_tx_report_confirmation;
     outcoming_msg->data = report_msg;
     outcoming_msg->size = REPORT_MSG_SIZE;
+    // Il report è ritrasmesso dallo stack se il canale è congestionato
+    outcoming_msg->maxRetries = REPORT_MAX_RETRIES;
+    outcoming_msg->backoff = REPORT_RETRY_BACKOFF;
 
     #ifdef DEBUG_ANCHOR
     debug_bytes_to_hex_digest(serial_output_buffer, outcoming_msg->data,
@@ -404,6 +526,7 @@ static void anchor_tx_report () {
     NWK_DataReq(outcoming_msg);
 
     request_busy = true;
+    report_in_flight = true;
 }
 
 static void anchor_tx_ping_confirmation (NWK_DataReq_t *req) {
@@ -413,9 +536,40 @@ static void anchor_tx_ping_confirmation (NWK_DataReq_t *req) {
 
 static void anchor_tx_report_confirmation (NWK_DataReq_t *req) {
     request_busy = false;
+    report_in_flight = false;
     (void) req;
 }
 
+#ifdef NWK_ENABLE_BEACONS
+static void rx_beacons (void) {
+    NWK_Beacon_t beacon;
+    NWK_DataInd_t ind;
+
+    while (NWK_GetBeacon(&beacon)) {
+        // Per ora solo i ping viaggiano come beacon
+        if (PING_ENDPOINT != beacon.dstEndpoint) continue;
+
+        ind.srcAddr = beacon.srcAddr;
+        ind.dstAddr = NWK_BROADCAST_ADDR;
+        ind.srcEndpoint = beacon.srcEndpoint;
+        ind.dstEndpoint = beacon.dstEndpoint;
+        ind.options = NWK_IND_OPT_BROADCAST | NWK_IND_OPT_LINK_LOCAL |
+                      NWK_IND_OPT_LOCAL;
+        ind.data = beacon.data;
+        ind.size = beacon.size;
+        ind.lqi = beacon.lqi;
+        ind.rssi = beacon.rssi;
+        ind.timestamp = beacon.timestamp;
+
+        #if DONGLE_ADDRESS == COORDINATOR_ADDRESS
+        coordinator_rx_ping(&ind);
+        #else
+        anchor_rx_ping(&ind);
+        #endif
+    }
+}
+#endif
+
 static bool coordinator_rx_ping (NWK_DataInd_t *ind) {
     #ifdef DEBUG_COORD
     debug_print_dataind_summary(ind);
@@ -469,7 +623,8 @@ static bool anchor_rx_ping (NWK_DataInd_t *ind) {
     update_report(report, ind->rssi);
 
     // Se il report è completo, lo preparo per la spedizione
-    if (report->received_ping_count >= SEND_EVERY_N_PINGS) {
+    // (se il precedente è ancora in trasmissione si riprova al prossimo ping)
+    if (report->received_ping_count >= SEND_EVERY_N_PINGS && !report_in_flight) {
         pack_report(report_msg, report);
         report_ready_to_send = true;
         // E resetto il report corrente
@@ -539,6 +694,148 @@ void debug_print_dataind_summary (NWK_DataInd_t *ind) {
     Serial.println(debug_message_formatted);
 }
 
+#ifdef STATS_DUMP
+static void print_stats (void) {
+    print_nwk_stats();
+    #ifdef SYS_ENABLE_TIMER_STATS
+    print_timer_stats();
+    #endif
+    #ifdef SYS_ENABLE_TICKLESS
+    print_sleep_stats();
+    #endif
+    // Per ultimo, così il monitor non conta il tempo delle altre stampe
+    #ifdef SYS_ENABLE_LOOP_MONITOR
+    print_loop_monitor();
+    #endif
+}
+#endif
+
+#ifdef STATS_DUMP
+static void print_nwk_stats (void) {
+    NWK_Stats_t *stats = NWK_Stats();
+
+    sprintf(serial_output_buffer,
+            "{'nwk':%u,'alloc_fail':%lu,'frames_max':%u,'small_max':%u,'rx_full':%u}\n",
+            DONGLE_ADDRESS, stats->allocFailures, stats->framesMaxUsed,
+            stats->smallFramesMaxUsed, stats->rxPoolFull);
+    Serial.print(serial_output_buffer);
+
+    // Allocazioni rifiutate per classe di traffico
+    sprintf(serial_output_buffer,
+            "{'cls':%u,'rx':%u,'app':%u,'ack':%u,'fwd':%u,'cmd':%u}\n",
+            DONGLE_ADDRESS,
+            stats->classExhausted[NWK_FRAME_CLASS_RX],
+            stats->classExhausted[NWK_FRAME_CLASS_APP_TX],
+            stats->classExhausted[NWK_FRAME_CLASS_ACK],
+            stats->classExhausted[NWK_FRAME_CLASS_FORWARD],
+            stats->classExhausted[NWK_FRAME_CLASS_COMMAND]);
+    Serial.print(serial_output_buffer);
+
+    // Sorgenti vive scartate dalla cache dei duplicati, ritrasmissioni
+    // dei broadcast (programmate, soppresse, saltate) e beacon persi
+    sprintf(serial_output_buffer,
+            "{'rx':%u,'dup_evict':%u,'rebc':%u,'supp':%u,'skip':%u,'bcn_drop':%u}\n",
+            DONGLE_ADDRESS, stats->duplicateEvictions, stats->rebroadcasts,
+            stats->rebroadcastsSuppressed, stats->rebroadcastsSkipped,
+            stats->beaconsDropped);
+    Serial.print(serial_output_buffer);
+
+    sprintf(serial_output_buffer, "{'tx':%u,'retries':%u,'aggregated':%u}\n",
+            DONGLE_ADDRESS, stats->txRetries, stats->aggregated);
+    Serial.print(serial_output_buffer);
+
+    // Istogramma dell'attesa in coda di trasmissione per classe di traffico,
+    // il bucket i conta le attese sotto NWK_TX_DELAY_RESOLUTION << i
+    for (uint8_t cls = 0; cls < NWK_FRAME_CLASSES_AMOUNT; cls++) {
+        uint16_t *h = stats->txQueueDelay[cls];
+
+        sprintf(serial_output_buffer,
+                "{'txq':%u,'cls':%u,'h':[%u,%u,%u,%u,%u,%u,%u,%u]}\n",
+                DONGLE_ADDRESS, cls, h[0], h[1], h[2], h[3], h[4], h[5],
+                h[6], h[7]);
+        Serial.print(serial_output_buffer);
+    }
+
+    NWK_StatsReset();
+
+    #if PHY_RX_BUFFERS_AMOUNT > 0
+    // Frame ricevuti e persi perché tutti i buffer di ricezione erano pieni
+    // o perché la lunghezza letta dalla radio non era valida
+    sprintf(serial_output_buffer, "{'phy':%u,'rx_overruns':%u,'rx_malformed':%u}\n",
+            DONGLE_ADDRESS, PHY_Stats()->rxOverruns, PHY_Stats()->rxMalformed);
+    Serial.print(serial_output_buffer);
+
+    PHY_StatsReset();
+    #endif
+}
+#endif
+
+#ifdef SYS_ENABLE_LOOP_MONITOR
+static void print_loop_monitor (void) {
+    SYS_MonitorStats_t *stats = SYS_MonitorStats();
+
+    // Gli handler sono stampati come indirizzi, da risolvere con il
+    // file .map del firmware
+    sprintf(serial_output_buffer, "{'monitor':%u,'loops':%lu,'over':%lu,",
+            DONGLE_ADDRESS, stats->iterations, stats->overBudget);
+    Serial.print(serial_output_buffer);
+    sprintf(serial_output_buffer, "'max':%lu,'p50':%lu,'p99':%lu,",
+            stats->worst.time, SYS_MonitorPercentile(50),
+            SYS_MonitorPercentile(99));
+    Serial.print(serial_output_buffer);
+    sprintf(serial_output_buffer, "'max_stage':%u,'max_handler':%u,",
+            stats->worst.stage,
+            (unsigned int) (uintptr_t) stats->worst.handler);
+    Serial.print(serial_output_buffer);
+    sprintf(serial_output_buffer, "'last_stage':%u,'last_handler':%u}\n",
+            stats->lastOverBudget.stage,
+            (unsigned int) (uintptr_t) stats->lastOverBudget.handler);
+    Serial.print(serial_output_buffer);
+
+    SYS_MonitorReset();
+}
+#endif
+
+#ifdef SYS_ENABLE_TIMER_STATS
+static void print_timer_stats (void) {
+    SYS_Timer_t *timer = NULL;
+
+    while (NULL != (timer = SYS_TimerStatsNext(timer))) {
+        sprintf(serial_output_buffer, "{'timer':%u,'handler':%u,'fired':%lu,",
+                DONGLE_ADDRESS, (unsigned int) (uintptr_t) timer->handler,
+                timer->stats.fired);
+        Serial.print(serial_output_buffer);
+        sprintf(serial_output_buffer, "'late':%lu,'late_max':%lu,'missed':%lu,",
+                timer->stats.lateness, timer->stats.maxLateness,
+                timer->missed);
+        Serial.print(serial_output_buffer);
+        sprintf(serial_output_buffer, "'time':%lu,'time_max':%lu}\n",
+                timer->stats.time, timer->stats.maxTime);
+        Serial.print(serial_output_buffer);
+    }
+
+    SYS_TimerStatsReset();
+}
+#endif
+
+#ifdef SYS_ENABLE_TICKLESS
+static void print_sleep_stats (void) {
+    HAL_SleepStats_t *stats = HAL_SleepStats();
+    uint32_t elapsed = micros() - stats->start;
+    // Millesimi del tempo passati da sveglio
+    uint32_t duty = 1000 - stats->sleepTime / (elapsed / 1000 + 1);
+
+    sprintf(serial_output_buffer, "{'sleep':%u,'slept':%lu,'duty':%lu,",
+            DONGLE_ADDRESS, stats->sleepTime, duty);
+    Serial.print(serial_output_buffer);
+    sprintf(serial_output_buffer, "'wakeups':%lu,'lat':%lu,'lat_max':%lu}\n",
+            stats->wakeups, stats->wakeLatency, stats->maxWakeLatency);
+    Serial.print(serial_output_buffer);
+
+    HAL_SleepStatsReset();
+}
+#endif
+
 void debug_bytes_to_hex_digest (char *dest, uint8_t *msg, size_t size) {
     dest[0] = '\0';
     for (size_t i = 0; i < size; i++) {
@@ -0,0 +1,149 @@
+/**
+ * \file sysTimer_bench.c
+ *
+ * \brief Host benchmark of the system timer backends
+ *
+ * Runs 600 s of simulated time in 1 ms steps with the given number of
+ * timers, half of them one-shot and half periodic, and restarts a random
+ * timer every 10 ms. Every seventh timer is long enough to reach the upper
+ * levels of the timing wheel. Build it once per backend, see the Makefile,
+ * and compare the reported run times.
+ *
+ * Usage: sysTimer_bench <timers>
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "lwm/sys/sysTimer.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define BENCH_MAX_TIMERS       500
+#define BENCH_STEPS            600000ul // 1 ms each
+#define BENCH_RESTART_PERIOD   10       // steps
+
+/*- Variables --------------------------------------------------------------*/
+static uint32_t benchTime = 1000000ul; // us
+static SYS_Timer_t benchTimers[BENCH_MAX_TIMERS];
+static uint32_t benchDue[BENCH_MAX_TIMERS]; // ms
+// Each timer draws its intervals from its own sequence, so both backends
+// see the same intervals whatever order they fire simultaneous timers in
+static uint32_t benchSeed[BENCH_MAX_TIMERS];
+static uint32_t benchFired;
+static uint32_t benchErrors;
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long millis(void)
+{
+  return benchTime / 1000;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long micros(void)
+{
+  return benchTime;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static uint32_t benchInterval(int i)
+{
+  benchSeed[i] = benchSeed[i] * 1103515245ul + 12345;
+  return 1 + (benchSeed[i] >> 8) % (0 == i % 7 ? 400000 : 3000);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void benchStart(int i)
+{
+  SYS_Timer_t *timer = &benchTimers[i];
+
+  if (SYS_TIMER_INTERVAL_MODE == timer->mode)
+    timer->interval = benchInterval(i);
+
+  SYS_TimerStart(timer);
+  benchDue[i] = millis() + timer->interval;
+}
+
+/*************************************************************************//**
+  @brief Checks that the timer fired on its due step and schedules the next
+         expiration
+*****************************************************************************/
+static void benchTimerHandler(SYS_Timer_t *timer)
+{
+  int i = timer - benchTimers;
+
+  benchFired++;
+
+  if (millis() != benchDue[i])
+  {
+    if (benchErrors < 5)
+      printf("timer %d fired at %lu, due at %lu\n", i, millis(), (unsigned long)benchDue[i]);
+    benchErrors++;
+  }
+
+  if (SYS_TIMER_PERIODIC_MODE == timer->mode)
+    benchDue[i] += timer->interval;
+  else
+    benchStart(i);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  int count = (argc > 1) ? atoi(argv[1]) : 0;
+  uint32_t restarts = 0;
+  clock_t start;
+
+  if (count < 1 || count > BENCH_MAX_TIMERS)
+  {
+    fprintf(stderr, "usage: %s <timers, 1-%d>\n", argv[0], BENCH_MAX_TIMERS);
+    return 2;
+  }
+
+  srand(1);
+  SYS_TimerInit();
+
+  for (int i = 0; i < count; i++)
+  {
+    benchSeed[i] = i;
+    benchTimers[i].mode = (i % 2) ? SYS_TIMER_PERIODIC_MODE : SYS_TIMER_INTERVAL_MODE;
+    benchTimers[i].interval = benchInterval(i);
+    benchTimers[i].handler = benchTimerHandler;
+    benchStart(i);
+  }
+
+  start = clock();
+
+  for (uint32_t step = 0; step < BENCH_STEPS; step++)
+  {
+    benchTime += 1000;
+    SYS_TimerTaskHandler();
+
+    if (0 == step % BENCH_RESTART_PERIOD)
+    {
+      int i = rand() % count;
+
+      SYS_TimerStop(&benchTimers[i]);
+      benchStart(i);
+      restarts++;
+    }
+  }
+
+  printf("%s: timers %d, fired %lu, restarts %lu, errors %lu, %.0f ms\n",
+#ifdef SYS_ENABLE_TIMER_WHEEL
+      "wheel",
+#else
+      "delta list",
+#endif
+      count, (unsigned long)benchFired, (unsigned long)restarts,
+      (unsigned long)benchErrors, (clock() - start) * 1000.0 / CLOCKS_PER_SEC);
+
+  return benchErrors ? 1 : 0;
+}
@@ -0,0 +1,358 @@
+/**
+ * \file nwkAggregate_sim.c
+ *
+ * \brief Host simulation of the frame aggregation in the network layer
+ *
+ * Runs the network layer of one node against a fake PHY that records the
+ * frames handed to it and confirms them on request. Checks that queued
+ * payloads to the same destination leave in one aggregate frame, that the
+ * requests are confirmed without the internal Tx flags, that a failed
+ * aggregate frame retries the payloads it carried, and that a received
+ * aggregate frame is split into one indication per payload.
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "lwm/phy/phy.h"
+#include "lwm/nwk/nwk.h"
+#include "lwm/nwk/nwkFrame.h"
+#include "lwm/sys/sysTimer.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SIM_ADDR               0x0001
+#define SIM_PEER_ADDR          0x0002
+#define SIM_PAN_ID             0x1234
+#define SIM_ENDPOINT           3
+#define SIM_STEP               100 // us
+#define SIM_REQUESTS           3
+
+#define SIM_CHECK(cond) \
+  do { if (!(cond)) { printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+      simErrors++; } } while (0)
+
+/*- Variables --------------------------------------------------------------*/
+volatile uint8_t SREG;
+static uint32_t simTime = 1000000ul; // us
+static int simErrors;
+
+// The frames the network layer handed to the PHY
+static uint8_t simAir[128];
+static uint8_t simAirSize;
+static uint8_t simAirFrames;
+
+static NWK_DataReq_t simReqs[SIM_REQUESTS];
+static uint8_t simConfirmed;
+
+static uint8_t simInds;
+static uint8_t simIndData[SIM_REQUESTS][8];
+static uint8_t simIndSize[SIM_REQUESTS];
+static uint16_t simIndSrc[SIM_REQUESTS];
+
+static uint8_t simPayloads[SIM_REQUESTS][3] = { "a", "bb", "ccc" };
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long millis(void)
+{
+  return simTime / 1000;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long micros(void)
+{
+  return simTime;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_SetPanId(uint16_t panId)
+{
+  (void)panId;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_SetShortAddr(uint16_t addr)
+{
+  (void)addr;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_Sleep(void)
+{
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+void PHY_Wakeup(void)
+{
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+uint16_t PHY_RandomReq(void)
+{
+  return 0x5a5a;
+}
+
+/*************************************************************************//**
+  @brief Records the frame, the test confirms it with PHY_DataConf()
+*****************************************************************************/
+void PHY_DataReqGather(uint8_t *header, uint8_t headerSize, uint8_t *payload, uint8_t payloadSize)
+{
+  memcpy(simAir, header, headerSize);
+  memcpy(simAir + headerSize, payload, payloadSize);
+  simAirSize = headerSize + payloadSize;
+  simAirFrames++;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simRun(uint32_t time)
+{
+  for (uint32_t i = 0; i < time / SIM_STEP; i++)
+  {
+    simTime += SIM_STEP;
+    SYS_TimerTaskHandler();
+    NWK_TaskHandler();
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simDataConf(NWK_DataReq_t *req)
+{
+  (void)req;
+  simConfirmed++;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static bool simDataInd(NWK_DataInd_t *ind)
+{
+  if (simInds < SIM_REQUESTS && ind->size <= sizeof(simIndData[0]))
+  {
+    memcpy(simIndData[simInds], ind->data, ind->size);
+    simIndSize[simInds] = ind->size;
+    simIndSrc[simInds] = ind->srcAddr;
+  }
+
+  simInds++;
+  return true;
+}
+
+/*************************************************************************//**
+  @brief Queues @a count aggregatable requests to the peer. They are one hop
+         away, so no route is needed.
+*****************************************************************************/
+static void simRequest(uint8_t count, uint8_t retries, uint8_t options)
+{
+  simConfirmed = 0;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    NWK_DataReq_t *req = &simReqs[i];
+
+    memset(req, 0, sizeof(NWK_DataReq_t));
+    req->dstAddr = SIM_PEER_ADDR;
+    req->dstEndpoint = SIM_ENDPOINT;
+    req->srcEndpoint = SIM_ENDPOINT;
+    req->options = NWK_OPT_AGGREGATE | NWK_OPT_LINK_LOCAL | options;
+    req->data = simPayloads[i];
+    req->size = i + 1;
+    req->maxRetries = retries;
+    req->backoff = 10;
+    req->confirm = simDataConf;
+    NWK_DataReq(req);
+  }
+}
+
+/*************************************************************************//**
+  @brief Checks that the last frame on the air is an aggregate frame that
+         carries the first @a count payloads
+*****************************************************************************/
+static void simCheckAggregate(uint8_t count)
+{
+  NwkFrameHeader_t *header = (NwkFrameHeader_t *)simAir;
+  uint8_t *data = simAir + sizeof(NwkFrameHeader_t);
+  uint8_t records = 0;
+
+  SIM_CHECK(header->nwkFcf.aggregate);
+  SIM_CHECK(SIM_PEER_ADDR == header->nwkDstAddr);
+
+  while (data + sizeof(NwkFrameAggregateRecord_t) <= simAir + simAirSize)
+  {
+    NwkFrameAggregateRecord_t *record = (NwkFrameAggregateRecord_t *)data;
+
+    data += sizeof(NwkFrameAggregateRecord_t);
+
+    // The records may come in any order, the payloads tell them apart
+    SIM_CHECK(record->size >= 1 && record->size <= count);
+    if (record->size >= 1 && record->size <= count)
+      SIM_CHECK(0 == memcmp(data, simPayloads[record->size - 1], record->size));
+
+    data += record->size;
+    records++;
+  }
+
+  SIM_CHECK(data == simAir + simAirSize);
+  SIM_CHECK(count == records);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simAggregateAndConfirm(void)
+{
+  printf("aggregate and confirm\n");
+
+  simAirFrames = 0;
+  simRequest(SIM_REQUESTS, 2, 0);
+  simRun(NWK_AGGREGATION_HOLD_TIME * 2);
+
+  SIM_CHECK(1 == simAirFrames);
+  simCheckAggregate(SIM_REQUESTS);
+  SIM_CHECK(0 == simConfirmed);
+
+  PHY_DataConf(PHY_STATUS_SUCCESS);
+  simRun(1000);
+
+  SIM_CHECK(SIM_REQUESTS == simConfirmed);
+  for (uint8_t i = 0; i < SIM_REQUESTS; i++)
+  {
+    SIM_CHECK(NWK_SUCCESS_STATUS == simReqs[i].status);
+    SIM_CHECK(0 == simReqs[i].control);
+    SIM_CHECK(0 == simReqs[i].retries);
+  }
+
+  // Nothing is sent again after the success
+  simRun(100000);
+  SIM_CHECK(1 == simAirFrames);
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simRetryAfterFailure(void)
+{
+  printf("retry the carried payloads after a failure\n");
+
+  simAirFrames = 0;
+  simRequest(2, 1, 0);
+  simRun(NWK_AGGREGATION_HOLD_TIME * 2);
+
+  SIM_CHECK(1 == simAirFrames);
+  simCheckAggregate(2);
+
+  PHY_DataConf(PHY_STATUS_CHANNEL_ACCESS_FAILURE);
+  simRun(1000);
+  SIM_CHECK(0 == simConfirmed);
+
+  // The backoff is 10 ms plus up to as much again at random
+  simRun(25000);
+
+  SIM_CHECK(2 == simAirFrames);
+  simCheckAggregate(2);
+
+  PHY_DataConf(PHY_STATUS_SUCCESS);
+  simRun(1000);
+
+  SIM_CHECK(2 == simConfirmed);
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    SIM_CHECK(NWK_SUCCESS_STATUS == simReqs[i].status);
+    SIM_CHECK(0 == simReqs[i].control);
+    SIM_CHECK(1 == simReqs[i].retries);
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simFailWithoutRetries(void)
+{
+  printf("confirm a failure once the retries are used up\n");
+
+  simAirFrames = 0;
+  simRequest(2, 0, NWK_OPT_RETRY_CHANNEL_ACCESS_ONLY);
+  simRun(NWK_AGGREGATION_HOLD_TIME * 2);
+
+  SIM_CHECK(1 == simAirFrames);
+
+  PHY_DataConf(PHY_STATUS_CHANNEL_ACCESS_FAILURE);
+  simRun(1000);
+
+  SIM_CHECK(2 == simConfirmed);
+  for (uint8_t i = 0; i < 2; i++)
+  {
+    SIM_CHECK(NWK_PHY_CHANNEL_ACCESS_FAILURE_STATUS == simReqs[i].status);
+    SIM_CHECK(0 == simReqs[i].control);
+  }
+}
+
+/*************************************************************************//**
+  @brief Sends the aggregate frame once more and feeds it back as if the
+         peer had sent it to this node
+*****************************************************************************/
+static void simSplit(void)
+{
+  NwkFrameHeader_t *header = (NwkFrameHeader_t *)simAir;
+  PHY_DataInd_t ind;
+
+  printf("split a received aggregate frame\n");
+
+  simAirFrames = 0;
+  simRequest(SIM_REQUESTS, 0, 0);
+  simRun(NWK_AGGREGATION_HOLD_TIME * 2);
+  SIM_CHECK(1 == simAirFrames);
+  PHY_DataConf(PHY_STATUS_SUCCESS);
+  simRun(1000);
+
+  header->macDstAddr = SIM_ADDR;
+  header->macSrcAddr = SIM_PEER_ADDR;
+  header->nwkDstAddr = SIM_ADDR;
+  header->nwkSrcAddr = SIM_PEER_ADDR;
+
+  ind.data = simAir;
+  ind.size = simAirSize;
+  ind.lqi = 255;
+  ind.rssi = -40;
+  ind.timestamp = simTime;
+
+  simInds = 0;
+  PHY_DataInd(&ind);
+  simRun(1000);
+
+  SIM_CHECK(SIM_REQUESTS == simInds);
+  for (uint8_t i = 0; i < SIM_REQUESTS && i < simInds; i++)
+  {
+    uint8_t size = simIndSize[i];
+
+    SIM_CHECK(SIM_PEER_ADDR == simIndSrc[i]);
+    SIM_CHECK(size >= 1 && size <= SIM_REQUESTS);
+    if (size >= 1 && size <= SIM_REQUESTS)
+      SIM_CHECK(0 == memcmp(simIndData[i], simPayloads[size - 1], size));
+  }
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+int main(void)
+{
+  SYS_TimerInit();
+  NWK_Init();
+  NWK_SetAddr(SIM_ADDR);
+  NWK_SetPanId(SIM_PAN_ID);
+  NWK_OpenEndpoint(SIM_ENDPOINT, simDataInd);
+
+  simAggregateAndConfirm();
+  simRetryAfterFailure();
+  simFailWithoutRetries();
+  simSplit();
+
+  printf("%s\n", simErrors ? "FAILED" : "ok");
+
+  return simErrors ? 1 : 0;
+}
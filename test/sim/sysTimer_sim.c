@@ -0,0 +1,140 @@
+/**
+ * \file sysTimer_sim.c
+ *
+ * \brief Host simulation of the periodic timer modes under a slow loop
+ *
+ * Runs one simulated hour with a 50 ms timer in each periodic mode. The main
+ * loop polls every 100 us, every handler takes 0.3 to 1 ms and the loop
+ * stalls for 120 ms every 200 ms. At the end each timer must have kept the
+ * phase it was started with; the plain and the catch-up periodic timers
+ * must also have fired every deadline, and only the deadline modes may
+ * count missed ones.
+ */
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "lwm/sys/sysTimer.h"
+
+/*- Definitions ------------------------------------------------------------*/
+#define SIM_INTERVAL           50       // ms
+#define SIM_DURATION           3600000000ul // us
+#define SIM_STEP               100      // us
+#define SIM_STALL_PERIOD       200000ul // us
+#define SIM_STALL              120000ul // us
+#define SIM_TIMERS             3
+
+/*- Variables --------------------------------------------------------------*/
+// Starts close to the wrap around, so the run crosses it
+static uint32_t simTime = 0xffffffff - 10000000ul; // us
+static SYS_Timer_t simTimers[SIM_TIMERS];
+static uint32_t simFired[SIM_TIMERS];
+static const SYS_TimerMode_t simModes[SIM_TIMERS] =
+{
+  SYS_TIMER_PERIODIC_MODE,
+  SYS_TIMER_PERIODIC_CATCH_UP_MODE,
+  SYS_TIMER_PERIODIC_SKIP_MODE,
+};
+static const char *simNames[SIM_TIMERS] = { "periodic", "catch up", "skip" };
+
+/*- Implementations --------------------------------------------------------*/
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long millis(void)
+{
+  return simTime / 1000;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+unsigned long micros(void)
+{
+  return simTime;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+static void simTimerHandler(SYS_Timer_t *timer)
+{
+  simFired[timer - simTimers]++;
+  simTime += 300 + rand() % 700;
+}
+
+/*************************************************************************//**
+*****************************************************************************/
+int main(void)
+{
+  uint32_t interval = SIM_INTERVAL * 1000ul;
+  uint32_t start = simTime;
+  uint32_t stall = 0;
+  uint32_t elapsed;
+  uint32_t deadlines;
+  int errors = 0;
+
+  srand(2);
+  SYS_TimerInit();
+
+  for (int i = 0; i < SIM_TIMERS; i++)
+  {
+    simTimers[i].mode = simModes[i];
+    simTimers[i].interval = SIM_INTERVAL;
+    simTimers[i].handler = simTimerHandler;
+    SYS_TimerStart(&simTimers[i]);
+  }
+
+  while ((simTime - start) < SIM_DURATION)
+  {
+    simTime += SIM_STEP;
+    stall += SIM_STEP;
+
+    if (stall >= SIM_STALL_PERIOD)
+    {
+      simTime += SIM_STALL;
+      stall = 0;
+    }
+
+    SYS_TimerTaskHandler();
+  }
+
+  // Let the timers catch up without stalls before looking at them
+  for (uint32_t i = 0; i < 1000000ul / SIM_STEP; i++)
+  {
+    simTime += SIM_STEP;
+    SYS_TimerTaskHandler();
+  }
+
+  elapsed = simTime - start;
+  deadlines = elapsed / interval;
+
+  printf("%s: %lu s simulated, %lu deadlines\n",
+#ifdef SYS_ENABLE_TIMER_WHEEL
+      "wheel",
+#else
+      "delta list",
+#endif
+      (unsigned long)(elapsed / 1000000ul), (unsigned long)deadlines);
+
+  for (int i = 0; i < SIM_TIMERS; i++)
+  {
+    SYS_Timer_t *timer = &simTimers[i];
+    uint32_t phase = (timer->deadline - start) % interval;
+    bool all = SYS_TIMER_PERIODIC_SKIP_MODE != timer->mode;
+    bool ok = 0 == phase;
+
+    if (all)
+      ok = ok && deadlines - simFired[i] <= 1;
+
+    if (SYS_TIMER_PERIODIC_MODE == timer->mode)
+      ok = ok && 0 == timer->missed;
+
+    printf("  %-8s fired %lu, missed %lu, phase error %lu us%s\n", simNames[i],
+        (unsigned long)simFired[i], (unsigned long)timer->missed,
+        (unsigned long)phase, ok ? "" : " FAILED");
+
+    if (!ok)
+      errors++;
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,22 @@
+/**
+ * \file Arduino.h
+ *
+ * \brief Host stand-in for the parts of the Arduino core used by the HAL
+ *
+ * The harnesses that include it provide millis() and micros() on top of
+ * a simulated clock, so the timers run as fast as the host allows.
+ */
+
+#ifndef _ARDUINO_H_
+#define _ARDUINO_H_
+
+/*- Includes ---------------------------------------------------------------*/
+#include <stdint.h>
+#include <stdbool.h>
+
+/*- Prototypes -------------------------------------------------------------*/
+unsigned long millis(void);
+unsigned long micros(void);
+void delayMicroseconds(unsigned int us); // not called from the host builds
+
+#endif // _ARDUINO_H_
@@ -0,0 +1,14 @@
+/**
+ * \file interrupt.h
+ *
+ * \brief Host stand-in for the AVR interrupt control, the host builds run in
+ *        a single context
+ */
+
+#ifndef _AVR_INTERRUPT_H_
+#define _AVR_INTERRUPT_H_
+
+#define sei()
+#define cli()
+
+#endif // _AVR_INTERRUPT_H_
@@ -0,0 +1,15 @@
+/**
+ * \file io.h
+ *
+ * \brief Host stand-in for the AVR register definitions used outside the PHY
+ */
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+/*- Variables --------------------------------------------------------------*/
+extern volatile uint8_t SREG; // defined by the harness
+
+#endif // _AVR_IO_H_
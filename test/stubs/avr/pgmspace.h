@@ -0,0 +1,13 @@
+/**
+ * \file pgmspace.h
+ *
+ * \brief Host stand-in for the AVR program memory access, the host has a
+ *        single address space
+ */
+
+#ifndef _AVR_PGMSPACE_H_
+#define _AVR_PGMSPACE_H_
+
+#define PROGMEM
+
+#endif // _AVR_PGMSPACE_H_
@@ -0,0 +1,10 @@
+/**
+ * \file wdt.h
+ *
+ * \brief Host stand-in for the AVR watchdog, which the host builds never use
+ */
+
+#ifndef _AVR_WDT_H_
+#define _AVR_WDT_H_
+
+#endif // _AVR_WDT_H_